@@ -0,0 +1,120 @@
+// Frustum culling benchmark: tests a grid of chunk bounds against the camera and
+// every shadow cascade, one Frustum::Intersects call at a time vs
+// util::IntersectsBatch.
+//
+// usage: bench_frustum [iterations]
+
+#include "game/chunk.hpp"
+#include "gfx/sun.hpp"
+#include "util/frustum.hpp"
+#include "util/simd.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace util;
+
+constexpr size_t numFrusta = 1 + gfx::Sun::maxCascades;
+
+// camera looking along +x from the middle of the grid, cascades looking down at an
+// angle with growing extents, similar to what the game produces
+std::array<Frustum, numFrusta> MakeFrusta() {
+  std::array<Frustum, numFrusta> frusta;
+  glm::vec3 eye(0, 0, 80);
+  auto proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  auto view = glm::lookAt(eye, eye + glm::vec3(1, 0.2, -0.1), glm::vec3(0, 0, 1));
+  frusta[0] = Frustum(proj * view);
+
+  glm::vec3 sunDir = glm::normalize(glm::vec3(0.3, 0.4, 1));
+  auto sunView = glm::lookAt(eye + sunDir * 500.0f, eye, glm::vec3(0, 0, 1));
+  for (size_t i = 1; i < numFrusta; i++) {
+    float extent = 32.0f * (1 << i);
+    auto sunProj = glm::ortho(-extent, extent, -extent, extent, 0.0f, 1000.0f);
+    frusta[i] = Frustum(sunProj * sunView);
+  }
+  return frusta;
+}
+
+// side x side chunk bounds centered on the origin
+AABBSoA MakeBoxes(int side) {
+  AABBSoA boxes;
+  boxes.Reserve(side * side);
+  for (int x = 0; x < side; x++) {
+    for (int y = 0; y < side; y++) {
+      glm::vec3 min(
+        (x - side / 2) * game::Chunk::SIZE.x, (y - side / 2) * game::Chunk::SIZE.y, 0
+      );
+      boxes.Push(AABB{min, min + glm::vec3(game::Chunk::SIZE)});
+    }
+  }
+  return boxes;
+}
+
+template <typename F>
+double TimeNs(int iterations, F &&func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) func();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+void Run(int side, int iterations, const std::array<Frustum, numFrusta> &frusta) {
+  auto boxes = MakeBoxes(side);
+  size_t numBoxes = boxes.Size();
+
+  // scalar path keeps AoS boxes like the callers did before
+  std::vector<AABB> aos(numBoxes);
+  for (size_t i = 0; i < numBoxes; i++) aos[i] = boxes.Get(i);
+
+  std::vector<uint8_t> scalarMasks(numBoxes);
+  std::vector<uint8_t> batchMasks(numBoxes);
+
+  double scalarNs = TimeNs(iterations, [&]() {
+    for (size_t i = 0; i < numBoxes; i++) {
+      uint8_t mask = 0;
+      for (size_t f = 0; f < numFrusta; f++) {
+        if (frusta[f].Intersects(aos[i])) mask |= 1 << f;
+      }
+      scalarMasks[i] = mask;
+    }
+  });
+  double batchNs =
+    TimeNs(iterations, [&]() { IntersectsBatch(frusta, boxes, batchMasks); });
+
+  size_t mismatches = 0;
+  size_t visible = 0;
+  for (size_t i = 0; i < numBoxes; i++) {
+    mismatches += scalarMasks[i] != batchMasks[i];
+    visible += batchMasks[i] & 1;
+  }
+
+  std::printf(
+    "%8zu %8zu %12.3f %12.3f %10.2f %12zu\n", numBoxes, visible, scalarNs / 1000,
+    batchNs / 1000, scalarNs / batchNs, mismatches
+  );
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+  if (iterations < 1) iterations = 1;
+
+  auto frusta = MakeFrusta();
+
+  std::printf(
+    "iterations: %d, frusta: %zu, simd width: %d\n", iterations, numFrusta, simd::width
+  );
+  std::printf(
+    "%8s %8s %12s %12s %10s %12s\n", "boxes", "visible", "scalar(us)", "batch(us)",
+    "speedup", "mismatches"
+  );
+
+  Run(32, iterations, frusta);  // 1k
+  Run(64, iterations, frusta);  // 4k
+  Run(128, iterations, frusta); // 16k
+
+  return 0;
+}
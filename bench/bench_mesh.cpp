@@ -0,0 +1,137 @@
+// Headless meshing benchmark: runs Chunk::BuildMesh on canned chunk fixtures
+// without a wgpu::Device and reports faces/sec, bytes produced and allocations.
+//
+// usage: bench_mesh [iterations]
+
+#include "game/chunk.hpp"
+#include "game/chunk_manager.hpp"
+#include "game/gen.hpp"
+#include "game/mesh.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+// allocation counting ------------------------------------------------
+static size_t g_allocCount = 0;
+
+void *operator new(size_t size) {
+  g_allocCount++;
+  if (void *ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+// fixtures -----------------------------------------------------------
+using namespace game;
+
+using Fixture = std::function<void(Chunk &chunk)>;
+
+void FillFlat(Chunk &chunk) {
+  for (size_t i = 0; i < Chunk::VOLUME; i++) {
+    auto pos = Chunk::IndexToPos(i);
+    if (pos.z < 64) chunk.SetBlock(pos, BlockId::Dirt);
+    else if (pos.z == 64) chunk.SetBlock(pos, BlockId::Grass);
+  }
+}
+
+void FillTerrain(Chunk &chunk) {
+  GenChunkData(chunk);
+}
+
+// every other block is solid, so every solid block emits all of its faces
+void FillCheckerboard(Chunk &chunk) {
+  for (size_t i = 0; i < Chunk::VOLUME; i++) {
+    auto pos = Chunk::IndexToPos(i);
+    if ((pos.x + pos.y + pos.z) % 2 == 0) chunk.SetBlock(pos, BlockId::Stone);
+  }
+}
+
+void FillLeaves(Chunk &chunk) {
+  for (size_t i = 0; i < Chunk::VOLUME; i++) {
+    chunk.SetBlock(Chunk::IndexToPos(i), BlockId::Leaf);
+  }
+}
+
+void FillOcean(Chunk &chunk) {
+  for (size_t i = 0; i < Chunk::VOLUME; i++) {
+    auto pos = Chunk::IndexToPos(i);
+    if (pos.z < 40) chunk.SetBlock(pos, BlockId::Stone);
+    else if (pos.z == 40) chunk.SetBlock(pos, BlockId::Sand);
+    else if (pos.z <= 64) chunk.SetBlock(pos, BlockId::Water);
+  }
+}
+
+// runner -------------------------------------------------------------
+void RunFixture(const char *name, const Fixture &fill, int iterations, int lod = 0) {
+  // center chunk with its 8 neighbors loaded, so border faces are tested as in-game
+  ChunkManager chunkManager;
+  const glm::ivec2 center(0, 0);
+  for (int x = -1; x <= 1; x++) {
+    for (int y = -1; y <= 1; y++) {
+      auto offset = center + glm::ivec2(x, y);
+      auto chunk = new Chunk(nullptr, nullptr, &chunkManager, offset);
+      fill(*chunk);
+      chunk->SetLod(lod);
+      chunkManager.chunks.emplace(offset, chunk);
+    }
+  }
+  Chunk &chunk = **chunkManager.GetChunk(center);
+
+  // first call allocates the mesh vectors from scratch, like a newly loaded chunk
+  size_t coldAllocs = g_allocCount;
+  chunk.BuildMesh();
+  coldAllocs = g_allocCount - coldAllocs;
+
+  size_t allocs = g_allocCount;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    chunk.BuildMesh();
+  }
+  auto end = std::chrono::steady_clock::now();
+  allocs = g_allocCount - allocs;
+
+  auto stats = chunk.GetMeshStats();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double msPerCall = seconds * 1000 / iterations;
+  double facesPerSec = stats.faceNum * iterations / seconds;
+
+  std::printf(
+    "%-14s %8zu %10zu %10.3f %12.2f %12zu %12.2f\n", name, stats.faceNum, stats.bytes,
+    msPerCall, facesPerSec / 1e6, coldAllocs, (double)allocs / iterations
+  );
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+  if (iterations < 1) iterations = 1;
+
+  InitMesh();
+  Chunk::InitSharedData();
+
+  std::printf("iterations: %d\n", iterations);
+  std::printf(
+    "%-14s %8s %10s %10s %12s %12s %12s\n", "fixture", "faces", "bytes", "ms/call",
+    "Mfaces/s", "allocs(cold)", "allocs/call"
+  );
+
+  RunFixture("flat", FillFlat, iterations);
+  RunFixture("terrain", FillTerrain, iterations);
+  RunFixture("checkerboard", FillCheckerboard, iterations);
+  RunFixture("leaves", FillLeaves, iterations);
+  RunFixture("ocean", FillOcean, iterations);
+  // downsampled meshes used for distant chunks
+  RunFixture("terrain lod1", FillTerrain, iterations, 1);
+  RunFixture("terrain lod2", FillTerrain, iterations, 2);
+
+  return 0;
+}
@@ -0,0 +1,51 @@
+// Profiler overhead benchmark: times empty PROFILE_ZONE scopes in a loop and
+// reports the cost per zone against the 50 ns budget. a zone is two Profiler::Now
+// reads plus the record, the read is timed alone to tell the two apart. each is the
+// best of a few runs so a busy machine doesn't count. exits with 1 over budget.
+//
+// usage: bench_profiler [zones]
+
+#include "util/profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+constexpr double budgetNs = 50;
+constexpr int runs = 5;
+
+template <typename F>
+double TimeNs(long iterations, F &&func) {
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) func();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (run == 0 || ns < best) best = ns;
+  }
+  return best / iterations;
+}
+
+int main(int argc, char **argv) {
+  long zones = argc > 1 ? std::atol(argv[1]) : 10'000'000;
+  if (zones < 1) zones = 1;
+
+  // the first zone registers this thread's ring, keep it out of the timing
+  {
+    PROFILE_ZONE("warm up");
+  }
+
+  volatile int64_t sink;
+  double nowNs = TimeNs(zones, [&]() { sink = util::Profiler::Now(); });
+  double zoneNs = TimeNs(zones, []() { PROFILE_ZONE("bench"); });
+
+  std::printf("zones: %ld, best of %d\n", zones, runs);
+  std::printf("%-10s %10s\n", "", "ns");
+  std::printf("%-10s %10.2f\n", "now", nowNs);
+  std::printf("%-10s %10.2f\n", "zone", zoneNs);
+  std::printf("%-10s %10.2f\n", "record", zoneNs - 2 * nowNs);
+  std::printf("%-10s %10.2f\n", "budget", budgetNs);
+
+  return zoneNs < budgetNs ? 0 : 1;
+}
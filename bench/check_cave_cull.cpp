@@ -0,0 +1,98 @@
+// Cave culling check: runs ChunkManager::CaveVisit on hand-built chunks without a
+// wgpu::Device. the camera sits in a pocket underground, a solid chunk walls it off
+// from a chunk holding a cave. a sealed cave must be culled, one a tunnel reaches
+// through the wall must not. exits with 1 on a wrong result.
+//
+// usage: check_cave_cull
+
+#include "game/chunk.hpp"
+#include "game/chunk_manager.hpp"
+#include "game/mesh.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <array>
+#include <cstdio>
+
+using namespace game;
+
+// stone below the surface, air above
+constexpr int surface = 64;
+// camera pocket and cave, both 8 block cubes starting at this height
+constexpr int caveBottom = 20;
+constexpr int caveSize = 8;
+
+void FillGround(Chunk &chunk) {
+  for (size_t i = 0; i < Chunk::VOLUME; i++) {
+    auto pos = Chunk::IndexToPos(i);
+    chunk.SetBlock(pos, pos.z < surface ? BlockId::Stone : BlockId::Air);
+  }
+}
+
+void CarvePocket(Chunk &chunk) {
+  glm::ivec3 min(4, 4, caveBottom);
+  glm::ivec3 pos;
+  for (pos.z = min.z; pos.z < min.z + caveSize; pos.z++) {
+    for (pos.y = min.y; pos.y < min.y + caveSize; pos.y++) {
+      for (pos.x = min.x; pos.x < min.x + caveSize; pos.x++) {
+        chunk.SetBlock(pos, BlockId::Air);
+      }
+    }
+  }
+}
+
+// 2x2 tunnel along x through the whole chunk, into both pockets
+void CarveTunnel(Chunk &chunk) {
+  for (int x = 0; x < Chunk::SIZE.x; x++) {
+    for (int y = 7; y <= 8; y++) {
+      for (int z = caveBottom + 2; z <= caveBottom + 3; z++) {
+        chunk.SetBlock({x, y, z}, BlockId::Air);
+      }
+    }
+  }
+}
+
+// chunks (0, 0) camera, (1, 0) wall and (2, 0) cave, false on a wrong result
+bool Run(const char *name, bool tunnel, bool expectVisible) {
+  ChunkManager chunkManager;
+  std::array<Chunk *, 3> row;
+  for (int x = 0; x < 3; x++) {
+    auto chunk = new Chunk(nullptr, nullptr, &chunkManager, {x, 0});
+    FillGround(*chunk);
+    if (x != 1) CarvePocket(*chunk);
+    if (tunnel) CarveTunnel(*chunk);
+    chunkManager.chunks.emplace(glm::ivec2(x, 0), chunk);
+    row[x] = chunk;
+  }
+  // the section graphs are built with the mesh
+  for (auto chunk : row) chunk->BuildMesh();
+
+  // in the camera pocket, looking along +x at the cave
+  glm::vec3 eye(8, 8, caveBottom + 3);
+  auto proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  auto view = glm::lookAt(eye, eye + glm::vec3(1, 0, 0), glm::vec3(0, 0, 1));
+  util::Frustum frustum(proj * view);
+
+  bool started = chunkManager.CaveVisit(eye, frustum);
+  uint64_t frame = row[0]->caveVisitFrame;
+  bool wallVisible = row[1]->caveVisitFrame == frame;
+  bool caveVisible = row[2]->caveVisitFrame == frame;
+  bool ok = started && wallVisible && caveVisible == expectVisible;
+
+  std::printf(
+    "%-10s %8s %8s %10s %6s\n", name, wallVisible ? "yes" : "no",
+    caveVisible ? "yes" : "no", expectVisible ? "yes" : "no", ok ? "ok" : "FAIL"
+  );
+  return ok;
+}
+
+int main() {
+  InitMesh();
+  Chunk::InitSharedData();
+
+  std::printf("%-10s %8s %8s %10s %6s\n", "fixture", "wall", "cave", "expected", "");
+  bool ok = true;
+  ok &= Run("sealed", false, false);
+  ok &= Run("tunnel", true, true);
+
+  return ok ? 0 : 1;
+}
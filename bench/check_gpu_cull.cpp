@@ -0,0 +1,128 @@
+// GPU culling check: runs GpuCuller::Cull over a fixed grid of chunk bounds without
+// a window, reads the draw counts back and compares them with util::Frustum on the
+// cpu. exits with 1 on a mismatch.
+//
+// usage: check_gpu_cull [--fallback]
+//   --fallback  use the software adapter (SwiftShader)
+
+#include "game.hpp"
+#include "gfx/context.hpp"
+#include "gfx/gpu_culler.hpp"
+#include "util/frustum.hpp"
+#include "util/webgpu-util.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace wgpu;
+using gfx::GpuCuller;
+using ChunkInfo = game::ChunkManager::ChunkInfo;
+
+constexpr int side = 32; // chunks
+
+// camera looking along +x from the middle of the grid, cascades looking down at an
+// angle with growing extents, like bench_frustum
+std::array<util::Frustum, GpuCuller::numViews> MakeFrusta() {
+  std::array<util::Frustum, GpuCuller::numViews> frusta;
+  glm::vec3 eye(0, 0, 80);
+  auto proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+  auto view = glm::lookAt(eye, eye + glm::vec3(1, 0.2, -0.1), glm::vec3(0, 0, 1));
+  frusta[0] = util::Frustum(proj * view);
+
+  glm::vec3 sunDir = glm::normalize(glm::vec3(0.3, 0.4, 1));
+  auto sunView = glm::lookAt(eye + sunDir * 500.0f, eye, glm::vec3(0, 0, 1));
+  for (size_t i = 1; i < GpuCuller::numViews; i++) {
+    float extent = 32.0f * (1 << i);
+    auto sunProj = glm::ortho(-extent, extent, -extent, extent, 0.0f, 1000.0f);
+    frusta[i] = util::Frustum(sunProj * sunView);
+  }
+  return frusta;
+}
+
+// side x side chunks centered on the origin. the mesh bounds are inset like real
+// ones, and some chunks have no opaque or no water mesh
+std::vector<ChunkInfo> MakeChunks() {
+  std::vector<ChunkInfo> chunks;
+  for (int x = 0; x < side; x++) {
+    for (int y = 0; y < side; y++) {
+      glm::vec3 min(
+        (x - side / 2) * game::Chunk::SIZE.x, (y - side / 2) * game::Chunk::SIZE.y, 0
+      );
+      size_t i = chunks.size();
+      float height = 40 + i % 7 * 8;
+      chunks.push_back({
+        .boundsMin = min + glm::vec3(0.5, 0.5, 0),
+        .opaqueIndexCount = i % 3 != 0 ? 36u : 0u,
+        .boundsMax = min + glm::vec3(glm::vec2(game::Chunk::SIZE) - 0.5f, height),
+        .waterIndexCount = i % 4 == 0 ? 6u : 0u,
+      });
+    }
+  }
+  return chunks;
+}
+
+int main(int argc, char **argv) {
+  bool fallback = argc > 1 && std::strcmp(argv[1], "--fallback") == 0;
+
+  gfx::Context ctx(fallback);
+  AdapterProperties properties;
+  ctx.adapter.GetProperties(&properties);
+  std::printf("adapter: %s\n", properties.name);
+
+  auto chunks = MakeChunks();
+  auto frusta = MakeFrusta();
+
+  // only the parts of the game state the culler reads
+  GameState state{};
+  state.chunkManager.chunkInfoBuffer = util::CreateStorageBuffer(
+    ctx.device, game::ChunkManager::maxChunks * sizeof(ChunkInfo)
+  );
+  state.chunkManager.numSlots = chunks.size();
+  util::WriteBuffer(
+    ctx.queue, state.chunkManager.chunkInfoBuffer, 0, chunks.data(),
+    chunks.size() * sizeof(ChunkInfo)
+  );
+
+  // the hi-z is never built, so occlusion stays off and only the frusta count
+  glm::uvec2 depthSize(64, 64);
+  Texture depthTexture = ctx.device.CreateTexture(ToPtr(TextureDescriptor{
+    .usage = TextureUsage::RenderAttachment | TextureUsage::TextureBinding,
+    .size = {depthSize.x, depthSize.y, 1},
+    .format = ctx.depthFormat,
+  }));
+  GpuCuller culler(&ctx, &state, depthTexture.CreateView(), depthSize);
+
+  CommandEncoder commandEncoder = ctx.device.CreateCommandEncoder();
+  culler.Cull(commandEncoder, frusta);
+  CommandBuffer commandBuffer = commandEncoder.Finish();
+  ctx.queue.Submit(1, &commandBuffer);
+  culler.ReadBack();
+  while (culler.ReadingBack()) ctx.device.Tick();
+
+  std::printf(
+    "chunks: %zu\n%6s %10s %10s %10s %10s\n", chunks.size(), "view", "opaque",
+    "expected", "water", "expected"
+  );
+  bool ok = true;
+  for (size_t view = 0; view < GpuCuller::numViews; view++) {
+    GpuCuller::DrawCounts expected{};
+    for (auto &chunk : chunks) {
+      if (chunk.opaqueIndexCount + chunk.waterIndexCount == 0) continue;
+      if (!frusta[view].Intersects({chunk.boundsMin, chunk.boundsMax})) continue;
+      expected.opaque += chunk.opaqueIndexCount > 0;
+      expected.water += chunk.waterIndexCount > 0;
+    }
+    auto counts = culler.drawCounts[view];
+    std::printf(
+      "%6zu %10u %10u %10u %10u\n", view, counts.opaque, expected.opaque, counts.water,
+      expected.water
+    );
+    ok &= counts.opaque == expected.opaque && counts.water == expected.water;
+  }
+
+  std::printf(ok ? "ok\n" : "MISMATCH\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+@group(0) @binding(0) var gBufferPosition: texture_2d<f32>;
+@group(0) @binding(1) var gBufferNormal: texture_2d<f32>;
+@group(0) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
+
+@group(1) @binding(0) var srcTexture: texture_2d<f32>;
+@group(1) @binding(1) var dstTexture: texture_storage_2d<r32float, write>;
+
+// separable depth-aware gaussian, run once along rows and once along columns. each
+// workgroup loads its line segment and the radius around it into workgroup memory
+const groupSize = 64;
+const radius = 4;
+const sigma = 2.5;
+// samples further than this fraction of the center's distance get no weight
+const depthTolerance = 0.05;
+
+// ao, view-space depth
+var<workgroup> line: array<vec2f, groupSize + 2 * radius>;
+
+fn Blur(coord: vec2i, lineStart: vec2i, step: vec2i, localIndex: i32) {
+  let size = vec2i(textureDimensions(srcTexture));
+  for (var i = localIndex; i < groupSize + 2 * radius; i += groupSize) {
+    let pos = clamp(lineStart + step * (i - radius), vec2i(0), size - 1);
+    line[i] = vec2f(
+      textureLoad(srcTexture, pos, 0).r, LoadPosition(pos).z
+    );
+  }
+  workgroupBarrier();
+
+  if (any(coord >= size)) {
+    return;
+  }
+  let center = line[localIndex + radius];
+  let tolerance = max(abs(center.y), 1.0) * depthTolerance;
+  var total = 0.0;
+  var weightSum = 0.0;
+  for (var i = -radius; i <= radius; i++) {
+    let tap = line[localIndex + radius + i];
+    let gaussian = exp(-f32(i * i) / (2.0 * sigma * sigma));
+    let weight = gaussian * max(1.0 - abs(tap.y - center.y) / tolerance, 0.0);
+    total += tap.x * weight;
+    weightSum += weight;
+  }
+  // the center always has weight 1
+  textureStore(dstTexture, coord, vec4f(total / weightSum, 0.0, 0.0, 1.0));
+}
+
+@compute @workgroup_size(groupSize, 1)
+fn cs_horizontal(
+  @builtin(global_invocation_id) id: vec3u,
+  @builtin(workgroup_id) group: vec3u,
+  @builtin(local_invocation_index) localIndex: u32,
+) {
+  let lineStart = vec2i(group.xy) * vec2i(groupSize, 1);
+  Blur(vec2i(id.xy), lineStart, vec2i(1, 0), i32(localIndex));
+}
+
+@compute @workgroup_size(1, groupSize)
+fn cs_vertical(
+  @builtin(global_invocation_id) id: vec3u,
+  @builtin(workgroup_id) group: vec3u,
+  @builtin(local_invocation_index) localIndex: u32,
+) {
+  let lineStart = vec2i(group.xy) * vec2i(1, groupSize);
+  Blur(vec2i(id.xy), lineStart, vec2i(0, 1), i32(localIndex));
+}
@@ -0,0 +1,113 @@
+struct ChunkInfo {
+  boundsMin: vec3f,
+  opaqueIndexCount: u32,
+  boundsMax: vec3f,
+  waterIndexCount: u32,
+}
+
+struct DrawIndexedIndirectArgs {
+  indexCount: u32,
+  instanceCount: u32,
+  firstIndex: u32,
+  baseVertex: i32,
+  firstInstance: u32,
+}
+
+struct CullParams {
+  // view proj the hi-z was built with (previous frame)
+  prevViewProj: mat4x4f,
+  // left, right, bottom, top, near, far
+  planes: array<vec4f, 6>,
+  numChunks: u32,
+  occlusion: u32,
+  hizSize: vec2f,
+}
+
+@group(0) @binding(0) var<uniform> params: CullParams;
+@group(0) @binding(1) var<storage, read> chunks: array<ChunkInfo>;
+@group(0) @binding(2) var<storage, read_write> opaqueArgs: array<DrawIndexedIndirectArgs>;
+@group(0) @binding(3) var<storage, read_write> waterArgs: array<DrawIndexedIndirectArgs>;
+// visible opaque and water draws, read back on the cpu
+@group(0) @binding(4) var<storage, read_write> drawCounts: array<atomic<u32>, 2>;
+@group(0) @binding(5) var hiz: texture_2d<f32>;
+
+fn InFrustum(boundsMin: vec3f, boundsMax: vec3f) -> bool {
+  for (var i = 0u; i < 6u; i++) {
+    let plane = params.planes[i];
+    // corner furthest along the plane normal
+    let corner = select(boundsMin, boundsMax, plane.xyz >= vec3f(0.0));
+    if (dot(plane.xyz, corner) + plane.w < 0.0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+fn IsOccluded(boundsMin: vec3f, boundsMax: vec3f) -> bool {
+  var rectMin = vec2f(1.0);
+  var rectMax = vec2f(0.0);
+  var nearest = 1.0;
+  for (var i = 0u; i < 8u; i++) {
+    let corner = select(
+      boundsMin, boundsMax, vec3<bool>((i & 1u) != 0u, (i & 2u) != 0u, (i & 4u) != 0u)
+    );
+    let clip = params.prevViewProj * vec4f(corner, 1.0);
+    // crosses the near plane, can't be tested against the depth buffer
+    if (clip.w <= 0.0) {
+      return false;
+    }
+    let ndc = clip.xyz / clip.w;
+    let uv = vec2f(ndc.x, -ndc.y) * 0.5 + 0.5;
+    rectMin = min(rectMin, uv);
+    rectMax = max(rectMax, uv);
+    nearest = min(nearest, ndc.z);
+  }
+  rectMin = clamp(rectMin, vec2f(0.0), vec2f(1.0));
+  rectMax = clamp(rectMax, vec2f(0.0), vec2f(1.0));
+
+  // pick the mip where the rect covers at most 2x2 texels
+  let rectSize = (rectMax - rectMin) * params.hizSize;
+  let maxLevel = textureNumLevels(hiz) - 1u;
+  let level = min(u32(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0)))), maxLevel);
+  let levelSize = vec2i(textureDimensions(hiz, level));
+  let texelMin = clamp(vec2i(rectMin * vec2f(levelSize)), vec2i(0), levelSize - 1);
+  let texelMax = clamp(vec2i(rectMax * vec2f(levelSize)), vec2i(0), levelSize - 1);
+
+  var farthest = 0.0;
+  for (var y = texelMin.y; y <= texelMax.y; y++) {
+    for (var x = texelMin.x; x <= texelMax.x; x++) {
+      farthest = max(farthest, textureLoad(hiz, vec2i(x, y), level).r);
+    }
+  }
+  return nearest > farthest;
+}
+
+@compute @workgroup_size(64)
+fn cs_main(@builtin(global_invocation_id) id: vec3u) {
+  let slot = id.x;
+  if (slot >= params.numChunks) {
+    return;
+  }
+  let chunk = chunks[slot];
+
+  var visible = chunk.opaqueIndexCount + chunk.waterIndexCount > 0u &&
+                InFrustum(chunk.boundsMin, chunk.boundsMax);
+  if (visible && params.occlusion != 0u) {
+    visible = !IsOccluded(chunk.boundsMin, chunk.boundsMax);
+  }
+
+  var opaque = DrawIndexedIndirectArgs(0u, 1u, 0u, 0, 0u);
+  var water = DrawIndexedIndirectArgs(0u, 1u, 0u, 0, 0u);
+  if (visible) {
+    opaque.indexCount = chunk.opaqueIndexCount;
+    water.indexCount = chunk.waterIndexCount;
+    if (opaque.indexCount > 0u) {
+      atomicAdd(&drawCounts[0], 1u);
+    }
+    if (water.indexCount > 0u) {
+      atomicAdd(&drawCounts[1], 1u);
+    }
+  }
+  opaqueArgs[slot] = opaque;
+  waterArgs[slot] = water;
+}
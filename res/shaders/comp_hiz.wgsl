@@ -0,0 +1,39 @@
+// hierarchical depth, each mip stores the farthest depth of the texels below it
+
+@group(0) @binding(0) var depthTexture: texture_depth_2d;
+@group(0) @binding(1) var srcTexture: texture_2d<f32>;
+@group(0) @binding(2) var dstTexture: texture_storage_2d<r32float, write>;
+
+// copies the depth buffer into mip 0
+@compute @workgroup_size(8, 8)
+fn cs_init(@builtin(global_invocation_id) id: vec3u) {
+  if (any(id.xy >= textureDimensions(dstTexture))) {
+    return;
+  }
+  let depth = textureLoad(depthTexture, id.xy, 0);
+  textureStore(dstTexture, id.xy, vec4f(depth, 0.0, 0.0, 1.0));
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_downsample(@builtin(global_invocation_id) id: vec3u) {
+  let size = textureDimensions(dstTexture);
+  if (any(id.xy >= size)) {
+    return;
+  }
+  let srcSize = textureDimensions(srcTexture);
+
+  // odd source sizes fold their last row/column into the last texel
+  let extra = vec2u(
+    select(0u, 1u, id.x == size.x - 1u && (srcSize.x & 1u) == 1u),
+    select(0u, 1u, id.y == size.y - 1u && (srcSize.y & 1u) == 1u)
+  );
+
+  var farthest = 0.0;
+  for (var y = 0u; y <= 1u + extra.y; y++) {
+    for (var x = 0u; x <= 1u + extra.x; x++) {
+      let pos = min(id.xy * 2u + vec2u(x, y), srcSize - 1u);
+      farthest = max(farthest, textureLoad(srcTexture, pos, 0).r);
+    }
+  }
+  textureStore(dstTexture, id.xy, vec4f(farthest, 0.0, 0.0, 1.0));
+}
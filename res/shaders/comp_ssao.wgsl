@@ -0,0 +1,120 @@
+@group(0) @binding(0) var<uniform> view: mat4x4f;
+@group(0) @binding(1) var<uniform> projection: mat4x4f;
+@group(0) @binding(2) var<uniform> inverseView: mat4x4f;
+
+@group(1) @binding(0) var gBufferPosition: texture_2d<f32>;
+@group(1) @binding(1) var gBufferNormal: texture_2d<f32>;
+@group(1) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
+
+@group(2) @binding(0) var<uniform> samples: array<vec4f, 64>;
+@group(2) @binding(1) var noiseTexture: texture_2d<f32>;
+@group(2) @binding(3) var<uniform> opts: Options;
+struct Options {
+  enabled: i32,
+  sampleSize: i32,
+  radius: f32,
+  bias: f32,
+  // advances every frame with temporal accumulation, 0 otherwise
+  frame: u32,
+}
+
+@group(3) @binding(0) var ssaoOutput: texture_storage_2d<r32float, write>;
+
+// same as frag_ssao.wgsl, but the depths around each 8x8 tile are loaded into
+// workgroup memory once. the radius shrinks near the camera so the kernel stays
+// within the apron, samples still landing outside fall back to the texture
+const tileSize = 8;
+const apron = 8;
+const sharedSize = tileSize + 2 * apron;
+// view-space depth, and 0 if the sample is skipped (fully transparent)
+var<workgroup> tileDepth: array<vec2f, sharedSize * sharedSize>;
+
+fn LoadDepth(coord: vec2i, size: vec2i) -> vec2f {
+  let position = LoadPosition(clamp(coord, vec2i(0), size - 1));
+  return vec2f(position.z, f32(position.w != 0.5));
+}
+
+fn SampleDepth(coord: vec2i, tileOrigin: vec2i, size: vec2i) -> vec2f {
+  let local = coord - tileOrigin;
+  if (all(local >= vec2i(0)) && all(local < vec2i(sharedSize))) {
+    return tileDepth[local.x + local.y * sharedSize];
+  }
+  return LoadDepth(coord, size);
+}
+
+@compute @workgroup_size(tileSize, tileSize)
+fn cs_main(
+  @builtin(global_invocation_id) id: vec3u,
+  @builtin(workgroup_id) group: vec3u,
+  @builtin(local_invocation_index) localIndex: u32,
+) {
+  let size = vec2i(textureDimensions(gBufferPosition));
+  let tileOrigin = vec2i(group.xy) * tileSize - apron;
+  for (var i = i32(localIndex); i < sharedSize * sharedSize; i += tileSize * tileSize) {
+    tileDepth[i] = LoadDepth(tileOrigin + vec2i(i % sharedSize, i / sharedSize), size);
+  }
+  workgroupBarrier();
+
+  let coord = vec2i(id.xy);
+  if (any(coord >= size)) {
+    return;
+  }
+  if (opts.enabled == 0) {
+    textureStore(ssaoOutput, coord, vec4f(1.0));
+    return;
+  }
+
+  let sampleNormal = LoadNormal(coord);
+  // normal.w is 0 if it's the sky
+  if (sampleNormal.w == 0.0) {
+    textureStore(ssaoOutput, coord, vec4f(1.0));
+    return;
+  }
+
+  var fragViewPos = LoadPosition(coord);
+  fragViewPos.w = 1.0;  // w might be 0.5, set to 1.0 for correct matrix multiplication
+  let fragWorldPos = (inverseView * fragViewPos).xyz;
+  let normal = sampleNormal.xyz;
+  // the noise texture repeats every 4 pixels
+  let noise = textureLoad(noiseTexture, coord % 4, 0).xyz;
+  // rotated by the golden angle every frame, so accumulated frames don't repeat
+  let rotation = f32(opts.frame) * 2.3999632;
+  let c = cos(rotation);
+  let s = sin(rotation);
+  let randomVec = vec3f(noise.x * c - noise.y * s, noise.x * s + noise.y * c, 0.0);
+
+  // create TBN change-of-basis matrix: from tangent-space to view-space
+  let tangent = normalize(randomVec - dot(randomVec, normal) * normal);
+  let bitangent = cross(normal, tangent);
+  let TBN = mat3x3f(tangent, bitangent, normal);
+
+  // pixels one unit of view space covers at this depth, along the wider axis
+  let scale = max(projection[0][0] * f32(size.x), projection[1][1] * f32(size.y));
+  let pixelsPerUnit = scale * 0.5 / -fragViewPos.z;
+  // kernel samples are at most radius away, a pixel short of the apron for rounding
+  let radius = min(opts.radius, f32(apron - 1) / pixelsPerUnit);
+
+  var occlusion = 0.0;
+  for (var i = 0; i < opts.sampleSize; i++) {
+    // later frames continue through the kernel where the last one stopped
+    let kernelIndex = (u32(i) + opts.frame * u32(opts.sampleSize)) % 64u;
+    var samplePos = TBN * samples[kernelIndex].xyz;
+    samplePos = fragWorldPos + samplePos * radius;
+    samplePos = (view * vec4f(samplePos, 1.0)).xyz;
+
+    var clipOffset = projection * vec4f(samplePos, 1.0);
+    clipOffset.y = -clipOffset.y;
+    let screenOffset = (clipOffset.xy / clipOffset.w) * 0.5 + 0.5;
+    let sampleCoord = vec2i(floor(screenOffset * vec2f(size)));
+
+    let sampleView = SampleDepth(sampleCoord, tileOrigin, size);
+    let sampleDepth = sampleView.x;
+    let rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragViewPos.z - sampleDepth));
+    occlusion += select(0.0, 1.0, sampleDepth >= samplePos.z + opts.bias) * rangeCheck *
+                 sampleView.y;
+  }
+  occlusion = 1.0 - (occlusion / f32(opts.sampleSize));
+
+  textureStore(ssaoOutput, coord, vec4f(occlusion, 0.0, 0.0, 1.0));
+}
@@ -0,0 +1,65 @@
+// #include "gbuffer.wgsl"
+
+struct VertexInput {
+  @location(0) position: vec3f,
+  @location(1) normal: vec3f,
+  @location(2) color: vec3f,
+}
+
+struct VertexOutput {
+  @builtin(position) position: vec4f,
+  @location(0) fragPos: vec3f,
+  @location(1) normal: vec3f,
+  @location(2) color: vec3f,
+}
+
+struct GBufferOutput {
+  @location(0) position : vec4f,
+  @location(1) normal : vec4f,
+  @location(2) albedo : vec4f,
+}
+
+@group(0) @binding(0) var<uniform> view: mat4x4f;
+@group(0) @binding(1) var<uniform> projection: mat4x4f;
+
+@vertex
+fn vs_main(in: VertexInput) -> VertexOutput {
+  let viewPos = view * vec4f(in.position, 1.0);
+
+  var out: VertexOutput;
+  out.position = projection * viewPos;
+  out.fragPos = viewPos.xyz;
+  out.normal = in.normal;
+  out.color = in.color;
+
+  return out;
+}
+
+fn Shade(in: VertexOutput) -> GBufferOutput {
+  var out: GBufferOutput;
+  out.position = vec4f(in.fragPos, 1.0);
+  out.normal = vec4f(normalize(in.normal), 1.0);
+  out.albedo = vec4f(in.color, 1.0);
+  return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> GBufferOutput {
+  return Shade(in);
+}
+
+// compact layout, see LoadNormal in frag_composite.wgsl
+struct CompactOutput {
+  @location(0) normal: vec4f,
+  @location(1) albedo: vec4f,
+}
+
+// position comes from depth, its w (surface) rides along with the normal
+@fragment
+fn fs_compact(in: VertexOutput) -> CompactOutput {
+  let full = Shade(in);
+  var out: CompactOutput;
+  out.normal = vec4f(EncodeOctahedral(full.normal.xyz), full.position.w, 0.0);
+  out.albedo = full.albedo;
+  return out;
+}
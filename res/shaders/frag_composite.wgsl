@@ -6,6 +6,8 @@
 @group(1) @binding(1) var gBufferNormal: texture_2d<f32>;
 @group(1) @binding(2) var gBufferAlbedo: texture_2d<f32>;
 @group(1) @binding(3) var gBufferSampler: sampler;
+@group(1) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
 
 @group(2) @binding(0) var<uniform> sunDir: vec3f;
 @group(2) @binding(1) var<storage> sunViewProjs: array<mat4x4f>;
@@ -13,8 +15,11 @@
 
 @group(3) @binding(0) var ssaoTexture: texture_2d<f32>;
 @group(3) @binding(1) var waterTexture: texture_2d<f32>;
-@group(3) @binding(2) var shadowMaps: texture_depth_2d_array;
+// every cascade's map is a square in one atlas
+@group(3) @binding(2) var shadowAtlas: texture_depth_2d;
 @group(3) @binding(3) var shadowSampler: sampler_comparison;
+// per cascade, xy is the rect's corner and zw its size, in atlas uv
+@group(3) @binding(4) var<uniform> shadowRects: array<vec4f, 5>;
 
 fn Blend(src: vec4f, dst: vec4f) -> vec4f {
   let outAlpha = dst.a;
@@ -36,13 +41,21 @@ fn ShadowCalculation(lightSpacePos: vec4f, normal: vec3f, cascadeLevel: i32) ->
   let scale = cascadeLevel; 
   let bias = 0.00005 + f32(scale) * 0.0001;
 
+  // into the cascade's rect, kept far enough from its edges that the 3x3 kernel
+  // never reads a neighboring cascade
+  let rect = shadowRects[cascadeLevel];
+  let texelSize = vec2f(1.0) / vec2f(textureDimensions(shadowAtlas));
+  let atlasCoords = clamp(
+    rect.xy + projCoords.xy * rect.zw, rect.xy + texelSize * 1.5,
+    rect.xy + rect.zw - texelSize * 1.5
+  );
+
   // sample over 3x3 area
   var depth = 0.0;
-  let texelSize = vec2f(1.0) / vec2f(textureDimensions(shadowMaps));
   for (var x = -1; x <= 1; x++) {
     for (var y = -1; y <= 1; y++) {
       let offset = vec2f(f32(x), f32(y)) * texelSize;
-      let sampleDepth = textureSampleCompareLevel(shadowMaps, shadowSampler, projCoords.xy + offset, cascadeLevel, projCoords.z - bias);
+      let sampleDepth = textureSampleCompareLevel(shadowAtlas, shadowSampler, atlasCoords + offset, projCoords.z - bias);
       depth += sampleDepth;
     }
   }
@@ -74,11 +87,12 @@ fn ShadowDebug(cascadeLevel: i32, ambientOcclusion: f32) -> vec4f {
 
 @fragment
 fn fs_main(@location(0) uv: vec2f) -> @location(0) vec4f {
-  var samplePos = textureSampleLevel(gBufferPosition, gBufferSampler, uv, 0.0);
+  let coord = vec2i(uv * vec2f(textureDimensions(gBufferPosition)));
+  var samplePos = LoadPosition(coord);
   samplePos.w = 1.0;  // w might be 0.5, set to 1.0 for correct matrix multiplication
   let position = (inverseView * samplePos).xyz;
 
-  let sampleNormal = textureSampleLevel(gBufferNormal, gBufferSampler, uv, 0.0);
+  let sampleNormal = LoadNormal(coord);
   let normal = sampleNormal.xyz;
   var albedo = textureSampleLevel(gBufferAlbedo, gBufferSampler, uv, 0.0).rgb;
   let ambientOcclusion = textureSampleLevel(ssaoTexture, gBufferSampler, uv, 0.0).r;
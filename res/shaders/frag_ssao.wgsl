@@ -6,6 +6,8 @@
 @group(1) @binding(1) var gBufferNormal: texture_2d<f32>;
 // @group(1) @binding(2) var gBufferAlbedo: texture_2d<f32>;
 @group(1) @binding(3) var gBufferSampler: sampler;
+@group(1) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
 
 @group(2) @binding(0) var<uniform> samples: array<vec4f, 64>;
 @group(2) @binding(1) var noiseTexture: texture_2d<f32>;
@@ -16,6 +18,8 @@ struct Options {
   sampleSize: i32,
   radius: f32,
   bias: f32,
+  // advances every frame with temporal accumulation, 0 otherwise
+  frame: u32,
 }
 
 @fragment
@@ -25,18 +29,25 @@ fn fs_main(@location(0) uv: vec2f) -> @location(0) f32 {
   }
 
   // get input for SSAO algorithm
-  let sampleNormal = textureSampleLevel(gBufferNormal, gBufferSampler, uv, 0.0);
+  let size = vec2i(textureDimensions(gBufferPosition));
+  let coord = vec2i(uv * vec2f(size));
+  let sampleNormal = LoadNormal(coord);
   // normal.w is 0 if it's the sky
   if (sampleNormal.w == 0.0) {
     return 1.0;
   }
 
-  var fragViewPos = textureSampleLevel(gBufferPosition, gBufferSampler, uv, 0.0);
+  var fragViewPos = LoadPosition(coord);
   fragViewPos.w = 1.0;  // w might be 0.5, set to 1.0 for correct matrix multiplication
   let fragWorldPos = (inverseView * fragViewPos).xyz;
   let normal = sampleNormal.xyz;
-  let noiseScale = vec2f(textureDimensions(gBufferPosition)) / 4.0;
-  let randomVec = textureSampleLevel(noiseTexture, noiseSampler, uv * noiseScale, 0.0).xyz;
+  let noiseScale = vec2f(size) / 4.0;
+  let noise = textureSampleLevel(noiseTexture, noiseSampler, uv * noiseScale, 0.0).xyz;
+  // rotated by the golden angle every frame, so accumulated frames don't repeat
+  let rotation = f32(opts.frame) * 2.3999632;
+  let c = cos(rotation);
+  let s = sin(rotation);
+  let randomVec = vec3f(noise.x * c - noise.y * s, noise.x * s + noise.y * c, 0.0);
 
   // create TBN change-of-basis matrix: from tangent-space to view-space
   let tangent = normalize(randomVec - dot(randomVec, normal) * normal);
@@ -46,7 +57,9 @@ fn fs_main(@location(0) uv: vec2f) -> @location(0) f32 {
   var occlusion = 0.0;
   for (var i = 0; i < opts.sampleSize; i++) {
     // get sample position
-    var samplePos = TBN * samples[i].xyz;
+    // later frames continue through the kernel where the last one stopped
+    let kernelIndex = (u32(i) + opts.frame * u32(opts.sampleSize)) % 64u;
+    var samplePos = TBN * samples[kernelIndex].xyz;
     samplePos = fragWorldPos + samplePos * opts.radius; 
     samplePos = (view * vec4f(samplePos, 1.0)).xyz;
 
@@ -55,7 +68,8 @@ fn fs_main(@location(0) uv: vec2f) -> @location(0) f32 {
     clipOffset.y = -clipOffset.y;
     let screenOffset = (clipOffset.xy / clipOffset.w) * 0.5 + 0.5;
 
-    let sampleView = textureSampleLevel(gBufferPosition, gBufferSampler, screenOffset, 0.0);
+    let sampleCoord = clamp(vec2i(floor(screenOffset * vec2f(size))), vec2i(0), size - 1);
+    let sampleView = LoadPosition(sampleCoord);
     // if object at position is fully transparent, will have w of 0.5
     let skip = f32(sampleView.w != 0.5);
     // if (sampleView.w == 0.5) { continue; }
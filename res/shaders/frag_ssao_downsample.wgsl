@@ -0,0 +1,33 @@
+@group(0) @binding(0) var gBufferPosition: texture_2d<f32>;
+@group(0) @binding(1) var gBufferNormal: texture_2d<f32>;
+@group(0) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
+
+struct FragmentOutput {
+  @location(0) position: vec4f,
+  @location(1) normal: vec4f,
+}
+
+// every half resolution texel keeps the closest of the 2x2 pixels it covers,
+// averaging them would make up a surface that isn't there
+@fragment
+fn fs_main(@builtin(position) fragCoord: vec4f) -> FragmentOutput {
+  let size = vec2i(textureDimensions(gBufferPosition));
+  let base = vec2i(fragCoord.xy) * 2;
+
+  // same as the gbuffer clear values, in case all four are sky
+  var out: FragmentOutput;
+  out.position = vec4f(0.0, 0.0, -10000.0, 0.0);
+  out.normal = vec4f(0.0);
+  for (var i = 0; i < 4; i++) {
+    let coord = min(base + vec2i(i & 1, i >> 1), size - 1);
+    let position = LoadPosition(coord);
+    let normal = LoadNormal(coord);
+    // view space looks down -z, closer is larger
+    if (normal.w != 0.0 && (out.normal.w == 0.0 || position.z > out.position.z)) {
+      out.position = position;
+      out.normal = normal;
+    }
+  }
+  return out;
+}
@@ -0,0 +1,51 @@
+@group(0) @binding(1) var<uniform> projection: mat4x4f;
+@group(0) @binding(2) var<uniform> inverseView: mat4x4f;
+@group(0) @binding(3) var<uniform> prevView: mat4x4f;
+
+@group(1) @binding(0) var gBufferPosition: texture_2d<f32>;
+@group(1) @binding(1) var gBufferNormal: texture_2d<f32>;
+@group(1) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
+
+// this frame's ao, and the history written last frame
+@group(2) @binding(0) var aoTexture: texture_2d<f32>;
+@group(2) @binding(1) var historyTexture: texture_2d<f32>;
+
+// frames blended at most, 8 frames of 8 samples cover the 64 sample kernel
+const maxHistory = 8.0;
+// history further than this fraction of the distance is something else
+const depthTolerance = 0.05;
+
+// history is (ao, view-space depth, frames accumulated). every pixel is reprojected
+// into last frame's view, and starts over where the history there doesn't match
+@fragment
+fn fs_main(@builtin(position) fragCoord: vec4f) -> @location(0) vec4f {
+  let coord = vec2i(fragCoord.xy);
+  let ao = textureLoad(aoTexture, coord, 0).r;
+  var viewPos = LoadPosition(coord);
+  // normal.w is 0 if it's the sky
+  if (LoadNormal(coord).w == 0.0) {
+    return vec4f(1.0, viewPos.z, 0.0, 0.0);
+  }
+  viewPos.w = 1.0;  // w might be 0.5, set to 1.0 for correct matrix multiplication
+
+  let prevViewPos = prevView * inverseView * viewPos;
+  var clipPos = projection * prevViewPos;
+  clipPos.y = -clipPos.y;
+  let prevUv = (clipPos.xy / clipPos.w) * 0.5 + 0.5;
+  let restart = vec4f(ao, viewPos.z, 1.0, 0.0);
+  if (clipPos.w <= 0.0 || any(prevUv < vec2f(0.0)) || any(prevUv >= vec2f(1.0))) {
+    return restart;
+  }
+
+  let historySize = vec2f(textureDimensions(historyTexture));
+  let history = textureLoad(historyTexture, vec2i(prevUv * historySize), 0);
+  // disoccluded, last frame saw another surface here
+  let tolerance = depthTolerance * max(abs(prevViewPos.z), 1.0);
+  if (abs(history.y - prevViewPos.z) > tolerance) {
+    return restart;
+  }
+
+  let count = min(history.z + 1.0, maxHistory);
+  return vec4f(mix(history.x, ao, 1.0 / count), viewPos.z, count, 0.0);
+}
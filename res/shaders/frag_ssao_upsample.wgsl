@@ -0,0 +1,62 @@
+@group(0) @binding(0) var gBufferPosition: texture_2d<f32>;
+@group(0) @binding(1) var gBufferNormal: texture_2d<f32>;
+@group(0) @binding(4) var<uniform> gBuffer: GBufferParams;
+// #include "gbuffer_load.wgsl"
+
+// half resolution ao and the gbuffer it was computed from
+@group(1) @binding(0) var ssaoTexture: texture_2d<f32>;
+@group(1) @binding(1) var halfPosition: texture_2d<f32>;
+@group(1) @binding(2) var halfNormal: texture_2d<f32>;
+
+// how fast weights fall off with depth difference, relative to distance
+const depthSharpness = 32.0;
+const normalPower = 8.0;
+
+// joint bilateral upsample, the bilinear weights of the 4 nearest half resolution
+// texels are scaled down where their depth or normal doesn't match this pixel, so
+// ao doesn't bleed across edges
+@fragment
+fn fs_main(@builtin(position) fragCoord: vec4f) -> @location(0) f32 {
+  let coord = vec2i(fragCoord.xy);
+  let normal = LoadNormal(coord);
+  // normal.w is 0 if it's the sky
+  if (normal.w == 0.0) {
+    return 1.0;
+  }
+  let depth = LoadPosition(coord).z;
+
+  let halfSize = vec2i(textureDimensions(ssaoTexture));
+  let halfCoord = fragCoord.xy * 0.5 - 0.5;
+  let base = vec2i(floor(halfCoord));
+  let f = fract(halfCoord);
+
+  var total = 0.0;
+  var weightSum = 0.0;
+  // fallback if every texel is rejected, e.g. thin geometry
+  var closestAo = 1.0;
+  var closestDiff = 1e30;
+  for (var i = 0; i < 4; i++) {
+    let offset = vec2i(i & 1, i >> 1);
+    let texel = clamp(base + offset, vec2i(0), halfSize - 1);
+    let bilinear = select(1.0 - f.x, f.x, offset.x == 1) *
+                   select(1.0 - f.y, f.y, offset.y == 1);
+
+    let sampleNormal = textureLoad(halfNormal, texel, 0);
+    let sampleDepth = textureLoad(halfPosition, texel, 0).z;
+    let ao = textureLoad(ssaoTexture, texel, 0).r;
+
+    let depthDiff = abs(sampleDepth - depth);
+    let depthWeight = exp(-depthDiff * depthSharpness / max(abs(depth), 1.0));
+    let normalWeight = pow(max(dot(normal.xyz, sampleNormal.xyz), 0.0), normalPower);
+    let weight = bilinear * depthWeight * normalWeight * f32(sampleNormal.w != 0.0);
+    total += ao * weight;
+    weightSum += weight;
+
+    if (sampleNormal.w != 0.0 && depthDiff < closestDiff) {
+      closestDiff = depthDiff;
+      closestAo = ao;
+    }
+  }
+
+  return select(closestAo, total / weightSum, weightSum > 1e-4);
+}
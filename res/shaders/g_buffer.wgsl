@@ -1,3 +1,5 @@
+// #include "gbuffer.wgsl"
+
 struct VertexInput {
   // 0  position (5 bits, 5 bits, 10 bits)
   // 20 uv (1 bit x 2)
@@ -46,8 +48,7 @@ fn vs_main(in: VertexInput) -> VertexOutput {
   return out;
 }
 
-@fragment
-fn fs_main(in: VertexOutput) -> GBufferOutput {
+fn Shade(in: VertexOutput) -> GBufferOutput {
   let texLoc = vec2f(f32((in.data1 >> 22u) & 0x0Fu), f32((in.data1 >> 26u) & 0x0Fu));
   let uv = (in.uv + texLoc) / 16.0;
   let transparency = (in.data1 >> 30u) & 0x03u;
@@ -88,3 +89,24 @@ fn fs_main(in: VertexOutput) -> GBufferOutput {
 
   return out;
 }
+
+@fragment
+fn fs_main(in: VertexOutput) -> GBufferOutput {
+  return Shade(in);
+}
+
+// compact layout, see LoadNormal in frag_composite.wgsl
+struct CompactOutput {
+  @location(0) normal: vec4f,
+  @location(1) albedo: vec4f,
+}
+
+// position comes from depth, its w (surface) rides along with the normal
+@fragment
+fn fs_compact(in: VertexOutput) -> CompactOutput {
+  let full = Shade(in);
+  var out: CompactOutput;
+  out.normal = vec4f(EncodeOctahedral(full.normal.xyz), full.position.w, 0.0);
+  out.albedo = full.albedo;
+  return out;
+}
@@ -1,12 +1,9 @@
 struct VertexInput {
+  // depth mesh, data1 of the full mesh without transparency
   // 0  position (5 bits, 5 bits, 10 bits)
   // 20 uv (1 bit x 2)
   // 22 texLoc (4 bits x 2)
-  // 30 transparency (2 bits)
   @location(0) data1: u32,
-  // 0 normal (2 bit x 3)
-  // 6 color (8 bit x 3)
-  @location(1) data2: u32,
 }
 
 struct VertexOutput {
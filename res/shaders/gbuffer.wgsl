@@ -0,0 +1,26 @@
+// g-buffer layouts, included with "// #include" (see util::LoadShaderModule)
+
+// which layout the g-buffer textures hold, see Renderer::compactGBuffer
+struct GBufferParams {
+  inverseProjection: mat4x4f,
+  // position is the depth buffer, normal is (octahedral normal, surface flag)
+  compact: u32,
+}
+
+// octahedral, the lower half folded over the diagonals
+fn EncodeOctahedral(n: vec3f) -> vec2f {
+  var e = n.xy / (abs(n.x) + abs(n.y) + abs(n.z));
+  if (n.z < 0.0) {
+    e = (1.0 - abs(e.yx)) * select(vec2f(-1.0), vec2f(1.0), e >= vec2f(0.0));
+  }
+  return e * 0.5 + 0.5;
+}
+
+fn DecodeOctahedral(encoded: vec2f) -> vec3f {
+  let e = encoded * 2.0 - 1.0;
+  var n = vec3f(e, 1.0 - abs(e.x) - abs(e.y));
+  let fold = max(-n.z, 0.0);
+  n.x += select(fold, -fold, n.x >= 0.0);
+  n.y += select(fold, -fold, n.y >= 0.0);
+  return normalize(n);
+}
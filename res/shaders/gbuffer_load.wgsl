@@ -0,0 +1,27 @@
+// reads either g-buffer layout. the including shader binds gBufferPosition,
+// gBufferNormal and gBuffer
+// #include "gbuffer.wgsl"
+
+// view-space position, w is 1 if opaque, 0.5 if fully transparent and 0 for the sky
+fn LoadPosition(coord: vec2i) -> vec4f {
+  let raw = textureLoad(gBufferPosition, coord, 0);
+  if (gBuffer.compact == 0u) {
+    return raw;
+  }
+  let surface = textureLoad(gBufferNormal, coord, 0).z;
+  if (surface == 0.0) {
+    return vec4f(0.0, 0.0, -10000.0, 0.0);  // the full layout's clear value
+  }
+  let uv = (vec2f(coord) + 0.5) / vec2f(textureDimensions(gBufferPosition));
+  let viewPos = gBuffer.inverseProjection * vec4f(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, raw.r, 1.0);
+  return vec4f(viewPos.xyz / viewPos.w, select(1.0, 0.5, surface < 0.75));
+}
+
+// w is 0 for the sky
+fn LoadNormal(coord: vec2i) -> vec4f {
+  let raw = textureLoad(gBufferNormal, coord, 0);
+  if (gBuffer.compact == 0u) {
+    return raw;
+  }
+  return vec4f(DecodeOctahedral(raw.xy), f32(raw.z != 0.0));
+}
@@ -1,11 +1,9 @@
 struct VertexInput {
+  // depth mesh, data1 of the full mesh without transparency
   // 0  position (5 bits, 5 bits, 10 bits)
   // 20 uv (1 bit x 2)
   // 22 texLoc (4 bits x 2)
-  // 30 transparency (2 bits)
   @location(0) data1: u32,
-  // 0 normal (2 bit x 3)
-  @location(1) data2: u32,
 }
 
 struct VertexOutput {
@@ -37,17 +35,21 @@ fn vs_main(in: VertexInput) -> VertexOutput {
   return out;
 }
 
+// only used by the alpha tested pipeline, the other one has no fragment stage
 @fragment
 fn fs_main(in: VertexOutput) {
   let texLoc = vec2f(f32((in.data1 >> 22u) & 0x0Fu), f32((in.data1 >> 26u) & 0x0Fu));
   let uv = (in.uv + texLoc) / 16.0;
-  let transparency = (in.data1 >> 30u) & 0x03u;
-
-  var color: vec4f;
-  if (transparency >= 2u) {
-    color = textureSampleLevel(texture, textureSampler, uv, 0.0);
-    if (color.a < 0.01) {
-        discard;
-    }
-  }  
+
+  let color = textureSampleLevel(texture, textureSampler, uv, 0.0);
+  if (color.a < 0.01) {
+    discard;
+  }
+}
+
+// full screen triangle on the far plane, the viewport limits it to one cascade
+@vertex
+fn vs_clear(@builtin(vertex_index) vertexIndex: u32) -> @builtin(position) vec4f {
+  let uv = vec2f(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+  return vec4f(uv * 2.0 - 1.0, 1.0, 1.0);
 }
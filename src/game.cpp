@@ -15,6 +15,7 @@
 #include "glm/gtx/string_cast.hpp"
 #include "gfx/context.hpp"
 #include "gfx/renderer.hpp"
+#include "util/frame_stats.hpp"
 #include "util/timer.hpp"
 #include "gfx/pipeline.hpp"
 
@@ -133,7 +134,9 @@ Game::Game() {
 
   while (!glfwWindowShouldClose(m_window)) {
     m_state.dt = timer.Tick();
-    m_state.fps = timer.GetFps();
+    // closes the counters of the frame before
+    util::frameStats.EndFrame(m_state.dt);
+    m_state.fps = util::frameStats.GetFps();
 
     // error callback
     m_ctx.device.Tick();
@@ -209,7 +212,6 @@ void Game::MouseButtonCallback(int button, int action, int mods) {
       if (castData) {
         auto [pos, dir] = *castData;
         m_state.chunkManager.SetBlockAndUpdate(pos, game::BlockId::Air);
-        m_state.sun.InvokeUpdate();
       }
     } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
       auto castData = game::Raycast(
@@ -220,7 +222,6 @@ void Game::MouseButtonCallback(int button, int action, int mods) {
         auto [pos, dir] = *castData;
         glm::ivec3 placePos = pos + game::g_DIR_OFFSETS[dir];
         m_state.chunkManager.SetBlockAndUpdate(placePos, m_state.currBlock);
-        m_state.sun.InvokeUpdate();
       }
     }
   }
@@ -0,0 +1,95 @@
+#include "cave_culling.hpp"
+#include "glm/vector_relational.hpp"
+
+namespace game {
+
+SectionGraph SectionGraph::Build(const std::bitset<VOLUME> &opaque) {
+  SectionGraph graph;
+  if (opaque.none()) return graph;
+  graph.links.fill(0);
+
+  std::bitset<VOLUME> filled = opaque;
+  std::array<uint16_t, VOLUME> stack;
+  for (size_t seed = 0; seed < VOLUME; seed++) {
+    if (filled[seed]) continue;
+
+    // faces touched by this region, all of them see each other
+    uint8_t faces = 0;
+    size_t top = 0;
+    stack[top++] = seed;
+    filled[seed] = true;
+    while (top > 0) {
+      size_t index = stack[--top];
+      glm::ivec3 pos(index % SIZE, (index / SIZE) % SIZE, index / (SIZE * SIZE));
+      if (pos.y == SIZE - 1) faces |= 1 << NORTH;
+      if (pos.y == 0) faces |= 1 << SOUTH;
+      if (pos.x == SIZE - 1) faces |= 1 << EAST;
+      if (pos.x == 0) faces |= 1 << WEST;
+      if (pos.z == SIZE - 1) faces |= 1 << TOP;
+      if (pos.z == 0) faces |= 1 << BOTTOM;
+
+      for (auto offset : g_DIR_OFFSETS) {
+        glm::ivec3 next = pos + offset;
+        if (glm::any(glm::lessThan(next, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(next, glm::ivec3(SIZE)))) {
+          continue;
+        }
+        size_t nextIndex = PosToIndex(next);
+        if (filled[nextIndex]) continue;
+        filled[nextIndex] = true;
+        stack[top++] = nextIndex;
+      }
+    }
+
+    for (int face = 0; face < 6; face++) {
+      if (faces & (1 << face)) graph.links[face] |= faces;
+    }
+  }
+  return graph;
+}
+
+bool CaveCuller::Traverse(
+  glm::ivec3 start, const util::Frustum &frustum, const SectionLookup &lookup,
+  const Visitor &visit
+) {
+  const SectionGraph *startGraph = lookup(start);
+  if (!startGraph) return false;
+
+  m_queue.clear();
+  m_visited.clear();
+  m_visited.insert(start);
+  visit(start);
+
+  // the camera can look out of its own section through any face
+  auto expand = [&](const Step &step, bool first) {
+    for (int dir = 0; dir < 6; dir++) {
+      auto direction = (Direction)dir;
+      if (step.traveled & (1 << DirOpposite(direction))) continue;
+      if (!first && !step.graph->Connected(step.entry, direction)) continue;
+
+      glm::ivec3 next = step.section + g_DIR_OFFSETS[dir];
+      if (m_visited.contains(next)) continue;
+      const SectionGraph *nextGraph = lookup(next);
+      if (!nextGraph) continue;
+      if (!frustum.Intersects(SectionBounds(next))) continue;
+
+      m_visited.insert(next);
+      visit(next);
+      m_queue.push_back(Step{
+        .section = next,
+        .graph = nextGraph,
+        .entry = DirOpposite(direction),
+        .traveled = uint8_t(step.traveled | (1 << dir)),
+      });
+    }
+  };
+
+  expand(Step{.section = start, .graph = startGraph, .traveled = 0}, true);
+  for (size_t i = 0; i < m_queue.size(); i++) {
+    Step step = m_queue[i];
+    expand(step, false);
+  }
+  return true;
+}
+
+} // namespace game
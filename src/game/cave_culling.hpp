@@ -0,0 +1,75 @@
+#pragma once
+
+#include "game/direction.hpp"
+#include "glm/common.hpp"
+#include "glm/ext/vector_int3.hpp"
+#include <glm/gtx/hash.hpp>
+#include "util/frustum.hpp"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+namespace game {
+
+// which faces of a 16^3 chunk section can see each other through non-opaque blocks.
+// built from block data alone, so it can be tested without a gpu
+struct SectionGraph {
+  static constexpr int SIZE = 16;
+  static constexpr size_t VOLUME = SIZE * SIZE * SIZE;
+
+  // bit (1 << b) of links[a] is set if face a connects to face b. sections that
+  // were never built are open on every face, so they never hide anything
+  std::array<uint8_t, 6> links = {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F};
+
+  bool Connected(Direction a, Direction b) const {
+    return links[a] & (1 << b);
+  }
+
+  static size_t PosToIndex(glm::ivec3 pos) {
+    return pos.x + pos.y * SIZE + pos.z * SIZE * SIZE;
+  }
+  // flood fills every region of non-opaque blocks, indexed with PosToIndex
+  static SectionGraph Build(const std::bitset<VOLUME> &opaque);
+};
+
+// breadth first search over sections from the camera, a section is only entered
+// through a face connected to the face the search came in from. directions are
+// never reversed along a path, which keeps the search from wrapping around
+// occluders. sections are (chunk x, chunk y, section z) and span SectionGraph::SIZE
+class CaveCuller {
+public:
+  // null if the section isn't loaded, the search doesn't go through it
+  using SectionLookup = std::function<const SectionGraph *(glm::ivec3 section)>;
+  using Visitor = std::function<void(glm::ivec3 section)>;
+
+private:
+  struct Step {
+    glm::ivec3 section;
+    const SectionGraph *graph;
+    Direction entry; // face the search came in through
+    uint8_t traveled; // (1 << Direction) taken so far
+  };
+  std::vector<Step> m_queue;
+  std::unordered_set<glm::ivec3> m_visited;
+
+public:
+  // visit is called once per reached section that intersects the frustum, start
+  // included. returns false without visiting anything if start isn't loaded
+  bool Traverse(
+    glm::ivec3 start, const util::Frustum &frustum, const SectionLookup &lookup,
+    const Visitor &visit
+  );
+
+  static glm::ivec3 SectionOf(glm::vec3 position) {
+    return glm::ivec3(glm::floor(position / float(SectionGraph::SIZE)));
+  }
+  static util::AABB SectionBounds(glm::ivec3 section) {
+    glm::vec3 min = section * SectionGraph::SIZE;
+    return util::AABB{min, min + float(SectionGraph::SIZE)};
+  }
+};
+
+} // namespace game
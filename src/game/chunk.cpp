@@ -4,6 +4,9 @@
 #include "game/direction.hpp"
 #include "game/mesh.hpp"
 #include "glm/ext/vector_uint3.hpp"
+#include "glm/vector_relational.hpp"
+#include "util/frame_stats.hpp"
+#include "util/profiler.hpp"
 #include "util/webgpu-util.hpp"
 #include "dawn/utils/WGPUHelpers.h"
 #include "game.hpp"
@@ -20,17 +23,6 @@ Chunk::Chunk(
       m_chunkManager(chunkManager) {
   m_worldOffset = glm::ivec3(offset * glm::ivec2(SIZE.x, SIZE.y), 0);
 
-  glm::vec3 worldOffset = m_worldOffset;
-  worldPosBuffer =
-    util::CreateUniformBuffer(ctx->device, sizeof(glm::vec3), &worldOffset);
-
-  bindGroup = dawn::utils::MakeBindGroup(
-    ctx->device, ctx->pipeline.chunkBGL,
-    {
-      {0, worldPosBuffer},
-    }
-  );
-
   // set all blocks to air
   std::fill(m_blockIdData.begin(), m_blockIdData.end(), BlockId::Air);
 }
@@ -51,7 +43,29 @@ void Chunk::InitSharedData() {
 }
 
 void Chunk::UpdateMesh() {
-  // generate out of bound blocks from neighboring chunks
+  PROFILE_ZONE("Chunk::UpdateMesh");
+  BuildMesh();
+  UploadMesh();
+}
+
+void Chunk::UpdateBorderMesh(uint8_t borders) {
+  PROFILE_ZONE("Chunk::UpdateBorderMesh");
+  // leaves spilling over from a new neighbor can land anywhere near the border.
+  // downsampled meshes are cheap enough to redo whole
+  if (m_lod > 0 || MergeNeighborLeaves()) {
+    UpdateMesh();
+    return;
+  }
+
+  for (auto border : {NORTH, SOUTH, EAST, WEST}) {
+    if (borders & (1 << border)) BuildBorderMesh(border);
+  }
+  UploadMesh();
+}
+
+// generate out of bound blocks from neighboring chunks, returns true if any were added
+bool Chunk::MergeNeighborLeaves() {
+  bool merged = false;
   for (int x = -1; x <= 1; x++) {
     for (int y = -1; y <= 1; y++) {
       if (!x && !y) continue;
@@ -71,109 +85,559 @@ void Chunk::UpdateMesh() {
         }
         auto index = Chunk::PosToIndex(localPos);
         m_blockIdData[index] = BlockId::Leaf;
+        merged = true;
         // TODO: fix leaf dissapearing after same generation
         it = outOfBoundLeafPositions.erase(it);
       }
     }
   }
+  return merged;
+}
+
+void Chunk::BuildMesh() {
+  MergeNeighborLeaves();
 
   m_opaqueData.Clear();
   // m_translucentData.Clear();
   m_waterData.Clear();
 
-  for (size_t i_block = 0; i_block < VOLUME; i_block++) {
-    const Cube &cube = m_cubeData[i_block];
-    BlockId blockId = m_blockIdData[i_block];
-    if (blockId == BlockId::Air) continue;
-    BlockType blockType = g_BLOCK_TYPES[(size_t)blockId];
-    auto posOffset = IndexToPos(i_block);
-
-    for (size_t i_face = 0; i_face < cube.faces.size(); i_face++) {
-      if (!ShouldRender(blockId, posOffset, (Direction)i_face)) continue;
-
-      const game::Face &faceSrc = cube.faces[i_face];
-      Chunk::Face face;
-      for (size_t i_vertex = 0; i_vertex < face.vertices.size(); i_vertex++) {
-        const Vertex &vertexSrc = faceSrc.vertices[i_vertex];
-        VertexAttribs &attribs = face.vertices[i_vertex];
-
-        // 0  position (5 bits, 5 bits, 10 bits)
-        // 20 uv (1 bit x 2)
-        // 22 texLoc (4 bits x 2)
-        // 30 transparency (2 bits)
-        glm::uvec3 position = vertexSrc.position;
-        glm::uvec2 texLoc = blockType.GetTextureLoc((Direction)i_face);
-        BitPackHelper(&attribs.data1).Set({
-          {position.x, 5},
-          {position.y, 5},
-          {position.z, 10},
-          {vertexSrc.uv.x, 1},
-          {vertexSrc.uv.y, 1},
-          {texLoc.x, 4},
-          {texLoc.y, 4},
-          {blockType.transparency, 2},
-        });
-
-        // 0 normal (2 bit x 3)
-        // map (-1, 1) to (0, 2)
-        glm::uvec3 normal = vertexSrc.normal + 1;
-        auto helper = BitPackHelper(&attribs.data2);
-        helper.Set({
-          {normal.x, 2},
-          {normal.y, 2},
-          {normal.z, 2},
-        });
-        if (blockId == BlockId::Light) {
-          helper.Set({
-            {255, 8},
-            {255, 8},
-            {255, 8},
-          });
+  if (m_lod > 0) {
+    BuildLodBlocks(); // blocks may have changed since SetLod
+    BuildLodMesh();
+  } else {
+    for (size_t i_block = 0; i_block < VOLUME; i_block++) {
+      BlockId blockId = m_blockIdData[i_block];
+      if (blockId == BlockId::Air) continue;
+
+      for (size_t i_face = 0; i_face < g_CUBE.faces.size(); i_face++) {
+        MeshFace(i_block, blockId, (Direction)i_face);
+      }
+    }
+  }
+
+  BuildSectionGraphs();
+  BuildOccluder();
+}
+
+void Chunk::SetLod(int lod) {
+  if (lod == m_lod) return;
+  // the old mesh's vectors can be several times bigger than the new one
+  if (lod > m_lod) {
+    m_opaqueData.Release();
+    m_waterData.Release();
+  }
+  m_lod = lod;
+  if (m_lod > 0) {
+    BuildLodBlocks();
+  } else {
+    m_lodBlocks = {};
+  }
+  dirty = true;
+}
+
+size_t Chunk::LodIndex(glm::ivec3 cell) {
+  glm::ivec3 cells = SIZE >> m_lod;
+  return cell.x + cell.y * cells.x + cell.z * cells.x * cells.y;
+}
+
+// each cell takes the most common block inside it, ties go to the later id so half
+// filled cells stay solid instead of turning into air
+void Chunk::BuildLodBlocks() {
+  const int scale = 1 << m_lod;
+  const glm::ivec3 cells = SIZE >> m_lod;
+  m_lodBlocks.resize(cells.x * cells.y * cells.z);
+
+  glm::ivec3 cell;
+  for (cell.z = 0; cell.z < cells.z; cell.z++) {
+    for (cell.y = 0; cell.y < cells.y; cell.y++) {
+      for (cell.x = 0; cell.x < cells.x; cell.x++) {
+        std::array<int, (size_t)BlockId::Last> counts{};
+        glm::ivec3 first = cell * scale, pos;
+        for (pos.z = first.z; pos.z < first.z + scale; pos.z++) {
+          for (pos.y = first.y; pos.y < first.y + scale; pos.y++) {
+            for (pos.x = first.x; pos.x < first.x + scale; pos.x++) {
+              counts[(size_t)GetBlock(pos)]++;
+            }
+          }
         }
+
+        size_t best = 0;
+        for (size_t id = 1; id < counts.size(); id++) {
+          if (counts[id] > 0 && counts[id] >= counts[best]) best = id;
+        }
+        m_lodBlocks[LodIndex(cell)] = (BlockId)best;
       }
+    }
+  }
+}
 
-      FaceIndex faceIndex;
-      for (size_t i = 0; i < g_FACE_INDICES.size(); i++) {
-        faceIndex.indices[i] = GetMeshData(blockId).faceNum * 4 + g_FACE_INDICES[i];
+// same rules as the full mesh, with cells as blocks. faces on the sides test the
+// neighbor's blocks as that neighbor meshes them, so both sides of an lod change
+// agree on what's open and the seam is never left with a gap
+void Chunk::BuildLodMesh() {
+  const int scale = 1 << m_lod;
+  const glm::ivec3 cells = SIZE >> m_lod;
+
+  glm::ivec3 cell;
+  for (cell.z = 0; cell.z < cells.z; cell.z++) {
+    for (cell.y = 0; cell.y < cells.y; cell.y++) {
+      for (cell.x = 0; cell.x < cells.x; cell.x++) {
+        BlockId blockId = m_lodBlocks[LodIndex(cell)];
+        if (blockId == BlockId::Air) continue;
+
+        for (size_t i_face = 0; i_face < g_CUBE.faces.size(); i_face++) {
+          auto direction = (Direction)i_face;
+          glm::ivec3 offset = g_DIR_OFFSETS[direction];
+          glm::ivec3 neighborCell = cell + offset;
+          bool border = neighborCell.x < 0 || neighborCell.x >= cells.x ||
+                        neighborCell.y < 0 || neighborCell.y >= cells.y;
+
+          bool visible;
+          if (neighborCell.z < 0) {
+            visible = false;
+          } else if (neighborCell.z >= cells.z) {
+            visible = true;
+          } else if (border) {
+            // 1 block thick slab of the neighbor along this face
+            glm::ivec3 min = cell * scale, max = min + scale;
+            for (int axis = 0; axis < 2; axis++) {
+              if (offset[axis] > 0) {
+                min[axis] = max[axis];
+                max[axis] += 1;
+              } else if (offset[axis] < 0) {
+                max[axis] = min[axis];
+                min[axis] -= 1;
+              }
+            }
+            visible = m_chunkManager->ShouldRender(
+              blockId, min + m_worldOffset, max + m_worldOffset
+            );
+          } else {
+            visible = FaceVisible(blockId, m_lodBlocks[LodIndex(neighborCell)]);
+          }
+          if (!visible) continue;
+
+          EmitFace(
+            g_CUBE.faces[direction], cell * scale, scale, blockId, direction, border
+          );
+        }
       }
+    }
+  }
+}
+
+void Chunk::BuildOccluder() {
+  static_assert(SIZE.x % occluderTile == 0 && SIZE.y % occluderTile == 0);
+  constexpr glm::ivec2 tiles(SIZE.x / occluderTile, SIZE.y / occluderTile);
+
+  // per tile, the longest run of layers where every block is opaque (start, size).
+  // caves split the runs
+  std::array<glm::ivec2, tiles.x * tiles.y> slabs{};
+  for (int tileY = 0; tileY < tiles.y; tileY++) {
+    for (int tileX = 0; tileX < tiles.x; tileX++) {
+      glm::ivec3 min(tileX * occluderTile, tileY * occluderTile, 0);
+      auto &best = slabs[tileY * tiles.x + tileX];
+      int runStart = 0;
+      for (int z = 0; z <= SIZE.z; z++) {
+        bool solid = z < SIZE.z;
+        for (int i = 0; solid && i < occluderTile * occluderTile; i++) {
+          glm::ivec3 pos = min + glm::ivec3(i % occluderTile, i / occluderTile, z);
+          solid = g_BLOCK_TYPES[(size_t)m_blockIdData[PosToIndex(pos)]].opaque;
+        }
+        if (solid) continue;
+        if (z - runStart > best.y) best = {runStart, z - runStart};
+        runStart = z + 1;
+      }
+    }
+  }
 
-      const std::array<uint32_t, 10> WIRE_FACE_INDICES = {
-        0, 1, 1, 2, 2, 3, 3, 0, 0, 2,
-      };
-      WireFaceIndex wireFaceIndex;
-      for (size_t i = 0; i < 10; i++) {
-        wireFaceIndex.indices[i] = GetMeshData(blockId).faceNum * 4 + WIRE_FACE_INDICES[i];
+  // greedy merge, a box grows along x over tiles with the same slab, then along y
+  // over whole rows of them. flat ground stays one box
+  occluders.clear();
+  std::array<bool, tiles.x * tiles.y> merged{};
+  auto mergeable = [&](int x, int y, glm::ivec2 slab) {
+    int i = y * tiles.x + x;
+    return !merged[i] && slabs[i] == slab;
+  };
+  for (int tileY = 0; tileY < tiles.y; tileY++) {
+    for (int tileX = 0; tileX < tiles.x; tileX++) {
+      glm::ivec2 slab = slabs[tileY * tiles.x + tileX];
+      if (slab.y == 0 || merged[tileY * tiles.x + tileX]) continue;
+
+      int width = 1;
+      while (tileX + width < tiles.x && mergeable(tileX + width, tileY, slab)) width++;
+      int height = 1;
+      for (; tileY + height < tiles.y; height++) {
+        bool row = true;
+        for (int x = tileX; row && x < tileX + width; x++) {
+          row = mergeable(x, tileY + height, slab);
+        }
+        if (!row) break;
       }
+      for (int y = tileY; y < tileY + height; y++) {
+        for (int x = tileX; x < tileX + width; x++) merged[y * tiles.x + x] = true;
+      }
+
+      glm::vec3 min =
+        m_worldOffset + glm::ivec3(tileX * occluderTile, tileY * occluderTile, slab.x);
+      glm::vec3 size(width * occluderTile, height * occluderTile, slab.y);
+      occluders.push_back(util::AABB{min, min + size});
+    }
+  }
+}
 
-      GetMeshData(blockId).AddFace(face, faceIndex, wireFaceIndex);
+void Chunk::BuildSectionGraphs() {
+  static_assert(SIZE.x == SectionGraph::SIZE && SIZE.y == SectionGraph::SIZE);
+  for (int section = 0; section < numSections; section++) {
+    std::bitset<SectionGraph::VOLUME> opaque;
+    glm::ivec3 pos;
+    for (pos.z = 0; pos.z < SectionGraph::SIZE; pos.z++) {
+      for (pos.y = 0; pos.y < SectionGraph::SIZE; pos.y++) {
+        for (pos.x = 0; pos.x < SectionGraph::SIZE; pos.x++) {
+          auto chunkPos = pos + glm::ivec3(0, 0, section * SectionGraph::SIZE);
+          BlockId blockId = m_blockIdData[PosToIndex(chunkPos)];
+          opaque[SectionGraph::PosToIndex(pos)] = g_BLOCK_TYPES[(size_t)blockId].opaque;
+        }
+      }
     }
+    sectionGraphs[section] = SectionGraph::Build(opaque);
+  }
+}
+
+// regenerates the faces of the 1 block thick slab that touches the given border
+void Chunk::BuildBorderMesh(Direction border) {
+  m_opaqueData.borderFaces[border].clear();
+  m_waterData.borderFaces[border].clear();
+
+  glm::ivec3 pos(0);
+  int *along;  // coordinate that runs along the border
+  int alongSize;
+  switch (border) {
+  case NORTH:
+    pos.y = SIZE.y - 1;
+    along = &pos.x;
+    alongSize = SIZE.x;
+    break;
+  case SOUTH:
+    pos.y = 0;
+    along = &pos.x;
+    alongSize = SIZE.x;
+    break;
+  case EAST:
+    pos.x = SIZE.x - 1;
+    along = &pos.y;
+    alongSize = SIZE.y;
+    break;
+  default:  // WEST
+    pos.x = 0;
+    along = &pos.y;
+    alongSize = SIZE.y;
+    break;
   }
 
+  for (pos.z = 0; pos.z < SIZE.z; pos.z++) {
+    for (*along = 0; *along < alongSize; (*along)++) {
+      size_t i_block = PosToIndex(pos);
+      BlockId blockId = m_blockIdData[i_block];
+      if (blockId == BlockId::Air) continue;
+      MeshFace(i_block, blockId, border);
+    }
+  }
+}
+
+void Chunk::MeshFace(size_t i_block, BlockId blockId, Direction direction) {
+  auto posOffset = IndexToPos(i_block);
+  if (!ShouldRender(blockId, posOffset, direction)) return;
+
+  // faces pointing out of the chunk sideways depend on that neighbor
+  glm::ivec3 neighborPos = posOffset + g_DIR_OFFSETS[direction];
+  bool border = neighborPos.x < 0 || neighborPos.x >= SIZE.x || neighborPos.y < 0 ||
+                neighborPos.y >= SIZE.y;
+
+  EmitFace(
+    m_cubeData[i_block].faces[direction], glm::ivec3(0), 1, blockId, direction, border
+  );
+}
+
+void Chunk::EmitFace(
+  const game::Face &faceSrc, glm::ivec3 offset, int scale, BlockId blockId,
+  Direction direction, bool border
+) {
+  BlockType blockType = g_BLOCK_TYPES[(size_t)blockId];
+
+  Chunk::Face face;
+  for (size_t i_vertex = 0; i_vertex < face.vertices.size(); i_vertex++) {
+    const Vertex &vertexSrc = faceSrc.vertices[i_vertex];
+    VertexAttribs &attribs = face.vertices[i_vertex];
+
+    // 0  position (5 bits, 5 bits, 10 bits)
+    // 20 uv (1 bit x 2)
+    // 22 texLoc (4 bits x 2)
+    // 30 transparency (2 bits)
+    glm::uvec3 position = offset + vertexSrc.position * scale;
+    glm::uvec2 texLoc = blockType.GetTextureLoc(direction);
+    BitPackHelper(&attribs.data1).Set({
+      {position.x, 5},
+      {position.y, 5},
+      {position.z, 10},
+      {vertexSrc.uv.x, 1},
+      {vertexSrc.uv.y, 1},
+      {texLoc.x, 4},
+      {texLoc.y, 4},
+      {blockType.transparency, 2},
+    });
+
+    // 0 normal (2 bit x 3)
+    // map (-1, 1) to (0, 2)
+    glm::uvec3 normal = vertexSrc.normal + 1;
+    auto helper = BitPackHelper(&attribs.data2);
+    helper.Set({
+      {normal.x, 2},
+      {normal.y, 2},
+      {normal.z, 2},
+    });
+    if (blockId == BlockId::Light) {
+      helper.Set({
+        {255, 8},
+        {255, 8},
+        {255, 8},
+      });
+    }
+  }
+
+  GetMeshData(blockId).AddFace(face, direction, border);
+}
+
+void Chunk::UploadMesh() {
+  util::frameStats.counters.chunksMeshed++;
+  bool hadMesh = HasMesh();
+  util::AABB oldBounds = meshBounds;
+
   m_opaqueData.CreateBuffers(m_ctx->device);
   // m_translucentData.CreateBuffers(m_ctx->device);
   m_waterData.CreateBuffers(m_ctx->device);
+  UploadDepthMesh();
+
+  util::AABB bounds{glm::vec3(SIZE), glm::vec3(0)};
+  m_opaqueData.ExpandBounds(bounds);
+  m_waterData.ExpandBounds(bounds);
+  if (glm::any(glm::greaterThan(bounds.min, bounds.max))) {
+    bounds = util::AABB{glm::vec3(0), glm::vec3(SIZE)}; // empty mesh
+  }
+  glm::vec3 worldOffset = m_worldOffset;
+  meshBounds = util::AABB{bounds.min + worldOffset, bounds.max + worldOffset};
+
+  if (m_chunkManager) {
+    m_chunkManager->WriteChunkInfo(*this);
+    // shadows of the old faces have to go too
+    util::AABB changed = meshBounds;
+    if (hadMesh) {
+      changed.min = glm::min(changed.min, oldBounds.min);
+      changed.max = glm::max(changed.max, oldBounds.max);
+    }
+    m_chunkManager->MeshChanged(changed);
+    m_chunkManager->meshVersion++; // new buffers, recorded draws are stale
+  }
 }
 
-void Chunk::Render(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex) {
-  passEncoder.SetBindGroup(groupIndex, bindGroup);
-  passEncoder.SetVertexBuffer(0, m_opaqueData.vbo, 0, m_opaqueData.vbo.GetSize());
-  passEncoder.SetIndexBuffer(
+// index data only depends on the face count, so every chunk uploads from this
+static const std::array<uint32_t, 10> WIRE_FACE_INDICES = {
+  0, 1, 1, 2, 2, 3, 3, 0, 0, 2,
+};
+static std::vector<FaceIndex> s_faceIndices;
+static std::vector<WireFaceIndex> s_wireFaceIndices;
+
+static void ReserveFaceIndices(size_t faceNum) {
+  for (size_t i_face = s_faceIndices.size(); i_face < faceNum; i_face++) {
+    FaceIndex faceIndex;
+    for (size_t i = 0; i < g_FACE_INDICES.size(); i++) {
+      faceIndex.indices[i] = i_face * 4 + g_FACE_INDICES[i];
+    }
+    s_faceIndices.push_back(faceIndex);
+
+    WireFaceIndex wireFaceIndex;
+    for (size_t i = 0; i < WIRE_FACE_INDICES.size(); i++) {
+      wireFaceIndex.indices[i] = i_face * 4 + WIRE_FACE_INDICES[i];
+    }
+    s_wireFaceIndices.push_back(wireFaceIndex);
+  }
+}
+
+void Chunk::UploadDepthMesh() {
+  static std::vector<DepthFace> s_depthFaces;
+  s_depthFaces.clear();
+
+  // same direction order as the opaque mesh, so indices can be shared
+  for (bool alphaTested : {false, true}) {
+    auto addFaces = [&](const std::vector<Face> &src) {
+      for (auto &face : src) {
+        if (((face.vertices[0].data1 >> 30) >= 2) != alphaTested) continue;
+        DepthFace depthFace;
+        for (size_t i = 0; i < depthFace.vertices.size(); i++) {
+          depthFace.vertices[i] = face.vertices[i].data1 & 0x3FFFFFFF;
+        }
+        s_depthFaces.push_back(depthFace);
+      }
+    };
+    for (int dir = 0; dir < 6; dir++) {
+      m_depthMesh.dirOffsets[alphaTested * 6 + dir] = s_depthFaces.size();
+      addFaces(m_opaqueData.faces[dir]);
+      if (dir < 4) addFaces(m_opaqueData.borderFaces[dir]);
+    }
+  }
+  m_depthMesh.dirOffsets[12] = s_depthFaces.size();
+
+  m_depthMesh.vbo = util::CreateVertexBuffer(
+    m_ctx->device, s_depthFaces.size() * sizeof(DepthFace), s_depthFaces.data()
+  );
+}
+
+void Chunk::MeshData::CreateBuffers(wgpu::Device &device) {
+  faceNum = FaceCount();
+  ReserveFaceIndices(faceNum);
+  util::frameStats.counters.facesEmitted += faceNum;
+
+  vbo = util::CreateVertexBuffer(device, faceNum * sizeof(Face));
+  size_t offset = 0;
+  auto writeFaces = [&](std::vector<Face> &src) {
+    if (src.empty()) return;
+    util::WriteBuffer(
+      device.GetQueue(), vbo, offset, src.data(), src.size() * sizeof(Face)
+    );
+    offset += src.size() * sizeof(Face);
+  };
+  for (int dir = 0; dir < 6; dir++) {
+    dirOffsets[dir] = offset / sizeof(Face);
+    writeFaces(faces[dir]);
+    if (dir < 4) writeFaces(borderFaces[dir]);
+  }
+  dirOffsets[6] = faceNum;
+
+  ebo = util::CreateIndexBuffer(
+    device, faceNum * sizeof(FaceIndex), s_faceIndices.data()
+  );
+  wireEbo = util::CreateIndexBuffer(
+    device, faceNum * sizeof(WireFaceIndex), s_wireFaceIndices.data()
+  );
+}
+
+void Chunk::MeshData::ExpandBounds(util::AABB &bounds) {
+  auto expand = [&](std::vector<Face> &src) {
+    for (auto &face : src) {
+      for (auto &vertex : face.vertices) {
+        glm::vec3 pos(
+          vertex.data1 & 0x1F, (vertex.data1 >> 5) & 0x1F, (vertex.data1 >> 10) & 0x3FF
+        );
+        bounds.min = glm::min(bounds.min, pos);
+        bounds.max = glm::max(bounds.max, pos);
+      }
+    }
+  };
+  for (auto &dirFaces : faces) expand(dirFaces);
+  for (auto &border : borderFaces) expand(border);
+}
+
+// dirOffsets holds the first face of each direction and the end, see MeshData::dirOffsets
+static void DrawDirRanges(
+  const wgpu::RenderBundleEncoder &bundleEncoder, const uint32_t *dirOffsets,
+  uint8_t dirMask
+) {
+  // faces share one index pattern, so a face range maps directly to an index range
+  for (int dir = 0; dir < 6;) {
+    if (!(dirMask & (1 << dir))) {
+      dir++;
+      continue;
+    }
+    int end = dir + 1;
+    while (end < 6 && (dirMask & (1 << end))) end++;
+    uint32_t count = dirOffsets[end] - dirOffsets[dir];
+    if (count > 0) {
+      bundleEncoder.DrawIndexed(count * 6, 1, dirOffsets[dir] * 6);
+      util::frameStats.drawsEncoded++;
+    }
+    dir = end;
+  }
+}
+
+void Chunk::MeshData::DrawDirs(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint8_t dirMask
+) {
+  DrawDirRanges(bundleEncoder, dirOffsets.data(), dirMask);
+}
+
+Chunk::MeshStats Chunk::GetMeshStats() {
+  MeshStats stats{};
+  for (auto *meshData : {&m_opaqueData, &m_waterData}) {
+    size_t faceNum = meshData->FaceCount();
+    stats.faceNum += faceNum;
+    stats.bytes += faceNum * (sizeof(Face) + sizeof(FaceIndex) + sizeof(WireFaceIndex));
+  }
+  return stats;
+}
+
+void Chunk::BindOrigin(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
+) {
+  uint32_t dynamicOffset = slot * ChunkManager::originStride;
+  bundleEncoder.SetBindGroup(
+    groupIndex, m_chunkManager->chunkBindGroup, 1, &dynamicOffset
+  );
+}
+
+void Chunk::Render(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex, uint8_t dirMask
+) {
+  if (m_opaqueData.FaceCount(dirMask) == 0) return;
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_opaqueData.vbo, 0, m_opaqueData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
+    m_opaqueData.ebo, IndexFormat::Uint32, 0, m_opaqueData.ebo.GetSize()
+  );
+  m_opaqueData.DrawDirs(bundleEncoder, dirMask);
+}
+
+void Chunk::RenderDepth(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  uint8_t dirMask, bool alphaTested
+) {
+  const uint32_t *dirOffsets = &m_depthMesh.dirOffsets[alphaTested * 6];
+  if (dirOffsets[6] == dirOffsets[0]) return;
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_depthMesh.vbo, 0, m_depthMesh.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
     m_opaqueData.ebo, IndexFormat::Uint32, 0, m_opaqueData.ebo.GetSize()
   );
-  passEncoder.DrawIndexed(m_opaqueData.indices.size() * 6);
+  DrawDirRanges(bundleEncoder, dirOffsets, dirMask);
+}
+
+uint8_t Chunk::FacingDirs(glm::vec3 eye) {
+  // a face is only front-facing if the eye is past its plane, and every plane of a
+  // direction is at or past the matching side of the bounds
+  auto &bounds = meshBounds;
+  uint8_t mask = 0;
+  if (eye.y > bounds.min.y) mask |= 1 << NORTH;
+  if (eye.y < bounds.max.y) mask |= 1 << SOUTH;
+  if (eye.x > bounds.min.x) mask |= 1 << EAST;
+  if (eye.x < bounds.max.x) mask |= 1 << WEST;
+  if (eye.z > bounds.min.z) mask |= 1 << TOP;
+  if (eye.z < bounds.max.z) mask |= 1 << BOTTOM;
+  return mask;
 }
 
-void Chunk::RenderWire(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex) {
-  passEncoder.SetBindGroup(groupIndex, bindGroup);
-  passEncoder.SetVertexBuffer(0, m_opaqueData.vbo, 0, m_opaqueData.vbo.GetSize());
-  passEncoder.SetIndexBuffer(
+void Chunk::RenderWire(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
+) {
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_opaqueData.vbo, 0, m_opaqueData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
     m_opaqueData.wireEbo, IndexFormat::Uint32, 0, m_opaqueData.wireEbo.GetSize()
   );
-  passEncoder.DrawIndexed(m_opaqueData.indices.size() * 10);
+  bundleEncoder.DrawIndexed(m_opaqueData.faceNum * 10);
+  util::frameStats.drawsEncoded++;
 }
 
 void Chunk::RenderTranslucent(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
   // record time
   // auto timer = dawn::utils::CreateTimer();
@@ -196,38 +660,82 @@ void Chunk::RenderTranslucent(
   // delete timer;
 
   // render
-  // passEncoder.SetVertexBuffer(
+  // bundleEncoder.SetVertexBuffer(
   //   0, m_translucentData.vbo, 0, m_translucentData.vbo.GetSize()
   // );
-  // passEncoder.SetIndexBuffer(
+  // bundleEncoder.SetIndexBuffer(
   //   m_translucentData.ebo, IndexFormat::Uint32, 0, m_translucentData.ebo.GetSize()
   // );
-  // passEncoder.DrawIndexed(m_translucentData.indices.size() * 6);
+  // bundleEncoder.DrawIndexed(m_translucentData.indices.size() * 6);
 
-  // passEncoder.SetIndexBuffer(ebo, IndexFormat::Uint32, 0, ebo.GetSize());
-  // passEncoder.DrawIndexed(sortedIndices.size() * 6);
+  // bundleEncoder.SetIndexBuffer(ebo, IndexFormat::Uint32, 0, ebo.GetSize());
+  // bundleEncoder.DrawIndexed(sortedIndices.size() * 6);
 }
 
 void Chunk::RenderWater(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
-  passEncoder.SetBindGroup(groupIndex, bindGroup);
-  passEncoder.SetVertexBuffer(0, m_waterData.vbo, 0, m_waterData.vbo.GetSize());
-  passEncoder.SetIndexBuffer(
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_waterData.vbo, 0, m_waterData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
     m_waterData.ebo, IndexFormat::Uint32, 0, m_waterData.ebo.GetSize()
   );
-  passEncoder.DrawIndexed(m_waterData.indices.size() * 6);
+  bundleEncoder.DrawIndexed(m_waterData.faceNum * 6);
+  util::frameStats.drawsEncoded++;
+}
+
+void Chunk::RenderIndirect(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+) {
+  if (m_opaqueData.faceNum == 0) return;
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_opaqueData.vbo, 0, m_opaqueData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
+    m_opaqueData.ebo, IndexFormat::Uint32, 0, m_opaqueData.ebo.GetSize()
+  );
+  bundleEncoder.DrawIndexedIndirect(indirectBuffer, indirectOffset);
+  util::frameStats.drawsEncoded++;
+}
+
+void Chunk::RenderDepthIndirect(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+) {
+  if (m_opaqueData.faceNum == 0) return;
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_depthMesh.vbo, 0, m_depthMesh.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
+    m_opaqueData.ebo, IndexFormat::Uint32, 0, m_opaqueData.ebo.GetSize()
+  );
+  bundleEncoder.DrawIndexedIndirect(indirectBuffer, indirectOffset);
+  util::frameStats.drawsEncoded++;
+}
+
+void Chunk::RenderWaterIndirect(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+) {
+  if (m_waterData.faceNum == 0) return;
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_waterData.vbo, 0, m_waterData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
+    m_waterData.ebo, IndexFormat::Uint32, 0, m_waterData.ebo.GetSize()
+  );
+  bundleEncoder.DrawIndexedIndirect(indirectBuffer, indirectOffset);
+  util::frameStats.drawsEncoded++;
 }
 
 void Chunk::RenderWaterWire(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
-  passEncoder.SetBindGroup(groupIndex, bindGroup);
-  passEncoder.SetVertexBuffer(0, m_waterData.vbo, 0, m_waterData.vbo.GetSize());
-  passEncoder.SetIndexBuffer(
+  BindOrigin(bundleEncoder, groupIndex);
+  bundleEncoder.SetVertexBuffer(0, m_waterData.vbo, 0, m_waterData.vbo.GetSize());
+  bundleEncoder.SetIndexBuffer(
     m_waterData.wireEbo, IndexFormat::Uint32, 0, m_waterData.wireEbo.GetSize()
   );
-  passEncoder.DrawIndexed(m_waterData.indices.size() * 10);
+  bundleEncoder.DrawIndexed(m_waterData.faceNum * 10);
+  util::frameStats.drawsEncoded++;
 }
 
 size_t Chunk::PosToIndex(glm::ivec3 pos) {
@@ -260,14 +768,43 @@ bool Chunk::ShouldRender(BlockId id, glm::ivec3 position, Direction direction) {
   }
   else if (neighborPos.x < 0 || neighborPos.x >= SIZE.x || 
            neighborPos.y < 0 || neighborPos.y >= SIZE.y) {
-    return m_chunkManager->ShouldRender(id, neighborPos + m_worldOffset);
+    auto worldPos = neighborPos + m_worldOffset;
+    return m_chunkManager->ShouldRender(id, worldPos, worldPos + 1);
   } else {
     return ShouldRender(id, neighborPos);
   }
 }
 
 bool Chunk::ShouldRender(BlockId id, glm::ivec3 neighborPos) {
-  auto neighborId = GetBlock(neighborPos);
+  return FaceVisible(id, GetBlock(neighborPos));
+}
+
+bool Chunk::ShouldRenderRegion(BlockId id, glm::ivec3 min, glm::ivec3 max) {
+  if (m_lod == 0) {
+    glm::ivec3 pos;
+    for (pos.z = min.z; pos.z < max.z; pos.z++) {
+      for (pos.y = min.y; pos.y < max.y; pos.y++) {
+        for (pos.x = min.x; pos.x < max.x; pos.x++) {
+          if (ShouldRender(id, pos)) return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  glm::ivec3 first = min >> m_lod, last = (max - 1) >> m_lod;
+  glm::ivec3 cell;
+  for (cell.z = first.z; cell.z <= last.z; cell.z++) {
+    for (cell.y = first.y; cell.y <= last.y; cell.y++) {
+      for (cell.x = first.x; cell.x <= last.x; cell.x++) {
+        if (FaceVisible(id, m_lodBlocks[LodIndex(cell)])) return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Chunk::FaceVisible(BlockId id, BlockId neighborId) {
   switch (id) {
   case BlockId::Water:
   case BlockId::Glass:
@@ -306,12 +843,13 @@ void Chunk::SetBlockAndUpdate(glm::ivec3 position, BlockId blockId) {
     position.x == 0,
   };
 
+  // offsets are in Direction order, the neighbor only needs its facing border redone
   for (size_t i = 0; i < 4; i++) {
     if (!neighborClose[i]) continue;
     auto neighborOffset = chunkOffset + neighborOffsets[i];
     auto chunk = m_chunkManager->GetChunk(neighborOffset);
     if (chunk) {
-      (*chunk)->dirty = true;
+      (*chunk)->dirtyBorders |= 1 << DirOpposite((Direction)i);
     }
   }
 
@@ -13,6 +13,7 @@
 #include "gfx/context.hpp"
 #include "util/frustum.hpp"
 #include "game/block.hpp"
+#include "game/cave_culling.hpp"
 #include "mesh.hpp"
 
 // forward decl
@@ -62,15 +63,33 @@ public:
   struct Face {
     std::array<VertexAttribs, 4> vertices;
   };
+  // data1 without the transparency bits, all the depth passes need
+  struct DepthFace {
+    std::array<uint32_t, 4> vertices;
+  };
 
   static constexpr glm::ivec3 SIZE = glm::ivec3(16, 16, 128);
   static constexpr size_t VOLUME = SIZE.x * SIZE.y * SIZE.z;
+  static constexpr uint8_t allDirs = 0x3F; // (1 << Direction) for all 6
 
   bool dirty;
+  // bitmask of (1 << Direction) for borders whose neighbor changed, cheaper than dirty
+  uint8_t dirtyBorders = 0;
   glm::ivec2 chunkOffset;
-
-  wgpu::Buffer worldPosBuffer;
-  wgpu::BindGroup bindGroup;
+  uint32_t slot = 0; // index into the chunk manager's per-chunk gpu buffers
+  // tight bounds of the uploaded opaque and water faces, for gpu culling
+  util::AABB meshBounds;
+  // directions whose faces can face the camera, see FacingDirs
+  uint8_t cameraDirMask = allDirs;
+  // stacked bottom to top, rebuilt with the mesh
+  static constexpr int numSections = SIZE.z / SectionGraph::SIZE;
+  std::array<SectionGraph, numSections> sectionGraphs;
+  uint64_t caveVisitFrame = 0; // last ChunkManager cave culling pass that reached it
+  // solid boxes for software occlusion (world space). the chunk is split into
+  // occluderTile wide columns, each gets its thickest slab of whole solid layers and
+  // neighbors with the same slab are merged, so hills stand out of the ground
+  static constexpr int occluderTile = 4;
+  std::vector<util::AABB> occluders;
 
   std::vector<glm::ivec3> outOfBoundLeafPositions;
 private:
@@ -84,70 +103,170 @@ private:
   static std::array<Cube, VOLUME> m_cubeData;
 
   std::array<BlockId, VOLUME> m_blockIdData; // block data
+
+  // (1 << m_lod) blocks per cell side, cells are the majority block of their blocks
+  int m_lod = 0;
+  std::vector<BlockId> m_lodBlocks; // empty at lod 0
+  size_t LodIndex(glm::ivec3 cell);
+  void BuildLodBlocks();
   // std::unordered_map<size_t, glm::vec3> m_lightColors;
 
   struct MeshData {
-    std::vector<Face> faces;
-    std::vector<FaceIndex> indices;
-    std::vector<WireFaceIndex> wireIndices;
+    // faces that only depend on blocks of this chunk, bucketed by direction
+    std::array<std::vector<Face>, 6> faces;
+    // faces on the chunk border pointing into a neighbor (north, south, east, west),
+    // kept apart so a single border can be regenerated when that neighbor changes
+    std::array<std::vector<Face>, 4> borderFaces;
     wgpu::Buffer vbo;
     wgpu::Buffer ebo;
     wgpu::Buffer wireEbo;
-    size_t faceNum;
+    size_t faceNum = 0; // faces in the gpu buffers
+    // first face of each direction in the gpu buffers, [6] is faceNum. every
+    // direction is one contiguous range so back-facing ones can be skipped
+    std::array<uint32_t, 7> dirOffsets{};
 
     void Clear() {
-      faces.clear();
-      indices.clear();
-      wireIndices.clear();
-      faceNum = 0;
+      for (auto &dirFaces : faces) dirFaces.clear();
+      for (auto &border : borderFaces) border.clear();
+    }
+    // also frees the capacity, for when the next mesh will be much smaller
+    void Release() {
+      faces = {};
+      borderFaces = {};
     }
 
-    void AddFace(Face face, FaceIndex index) {
-      faces.push_back(face);
-      indices.push_back(index);
-      faceNum++;
+    void AddFace(Face face, Direction direction, bool border) {
+      if (border) borderFaces[direction].push_back(face);
+      else faces[direction].push_back(face);
     }
 
-    void AddFace(Face face, FaceIndex index, WireFaceIndex wireIndex) {
-      faces.push_back(face);
-      indices.push_back(index);
-      wireIndices.push_back(wireIndex);
-      faceNum++;
+    size_t FaceCount() {
+      size_t count = 0;
+      for (auto &dirFaces : faces) count += dirFaces.size();
+      for (auto &border : borderFaces) count += border.size();
+      return count;
     }
 
-    void CreateBuffers(wgpu::Device &device) {
-      vbo = util::CreateVertexBuffer(device, faces.size() * sizeof(Face), faces.data());
-      ebo = util::CreateIndexBuffer(
-        device, indices.size() * sizeof(FaceIndex), indices.data()
-      );
-      wireEbo = util::CreateIndexBuffer(
-        device, wireIndices.size() * sizeof(WireFaceIndex), wireIndices.data()
-      );
+    // faces of the directions in dirMask that were uploaded
+    uint32_t FaceCount(uint8_t dirMask) {
+      uint32_t count = 0;
+      for (int dir = 0; dir < 6; dir++) {
+        if (dirMask & (1 << dir)) count += dirOffsets[dir + 1] - dirOffsets[dir];
+      }
+      return count;
     }
+
+    // writes each direction's interior then border faces, indices are generated on
+    // upload
+    void CreateBuffers(wgpu::Device &device);
+    // grows bounds (chunk local) to include every vertex
+    void ExpandBounds(util::AABB &bounds);
+    // one draw per run of consecutive directions in dirMask
+    void DrawDirs(const wgpu::RenderBundleEncoder &bundleEncoder, uint8_t dirMask);
   };
 
   MeshData m_opaqueData;
   MeshData m_translucentData;
   MeshData m_waterData;
 
+  // position only copy of the opaque mesh for the shadow and depth passes, built on
+  // upload. shares the opaque ebo, since it holds the same number of faces
+  struct DepthMesh {
+    wgpu::Buffer vbo;
+    // first face of each direction, [0, 6) don't need the alpha test and [6, 12) do,
+    // [12] is the face count
+    std::array<uint32_t, 13> dirOffsets{};
+  } m_depthMesh;
+  void UploadDepthMesh();
+
   MeshData &GetMeshData(BlockId id) {
     if (id == BlockId::Water) return m_waterData;
     if (g_BLOCK_TYPES[(size_t)id].transparency == 1) return m_translucentData;
     return m_opaqueData;
   }
 
+  // binds the chunk manager's shared origin buffer at this chunk's slot
+  void BindOrigin(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+
+  bool MergeNeighborLeaves();
+  void MeshFace(size_t i_block, BlockId blockId, Direction direction);
+  // packs faceSrc, with positions scaled and then offset (chunk local)
+  void EmitFace(
+    const game::Face &faceSrc, glm::ivec3 offset, int scale, BlockId blockId,
+    Direction direction, bool border
+  );
+  void BuildLodMesh();
+  void BuildBorderMesh(Direction border);
+  void BuildSectionGraphs();
+  void BuildOccluder();
+
 public:
+  struct MeshStats {
+    size_t faceNum;
+    size_t bytes; // cpu-side faces and indices
+  };
+
+  // ctx can be null for headless meshing, the mesh is never uploaded then
   Chunk(gfx::Context *ctx, GameState *state, ChunkManager *chunkManager, glm::ivec2 offset);
 
   static void InitSharedData();
 
   void UpdateMesh();
-  void Render(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderTranslucent(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderWater(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
+  // only regenerates the faces of the given border slabs, see dirtyBorders
+  void UpdateBorderMesh(uint8_t borders);
+  // cpu side of UpdateMesh, fills the mesh data without touching the gpu
+  void BuildMesh();
+  void UploadMesh();
+  MeshStats GetMeshStats();
+  // false until the first upload, chunks can wait in the remesh backlog
+  bool HasMesh() {
+    return m_opaqueData.vbo.Get() != nullptr;
+  }
+  // only draws the opaque faces of the directions in dirMask
+  void Render(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    uint8_t dirMask = allDirs
+  );
+  // directions with a face plane the eye can be in front of, from the mesh bounds
+  uint8_t FacingDirs(glm::vec3 eye);
+  // opaque faces from the depth mesh, either the ones without or with alpha testing
+  void RenderDepth(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    uint8_t dirMask, bool alphaTested
+  );
+  uint32_t GetFaceCount(uint8_t dirMask) {
+    return m_opaqueData.FaceCount(dirMask);
+  }
+  void RenderTranslucent(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  void RenderWater(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+
+  void RenderWire(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  void RenderWaterWire(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  // draw args come from the gpu culling pass, see gfx::GpuCuller
+  void RenderIndirect(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+  );
+  // every face of the depth mesh, needs the alpha tested pipeline
+  void RenderDepthIndirect(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+  );
+  void RenderWaterIndirect(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    const wgpu::Buffer &indirectBuffer, uint64_t indirectOffset
+  );
+  uint32_t GetIndexCount(bool water) {
+    return (water ? m_waterData : m_opaqueData).faceNum * 6;
+  }
 
-  void RenderWire(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderWaterWire(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
+  // 2x and 4x downsampled meshes for distant chunks
+  static constexpr int maxLod = 2;
+  int GetLod() {
+    return m_lod;
+  }
+  // rebuilds the downsampled blocks right away, neighbors read them when meshing
+  void SetLod(int lod);
 
   static size_t PosToIndex(glm::ivec3 pos);
   static glm::ivec3 IndexToPos(size_t index);
@@ -155,6 +274,10 @@ public:
   static bool ValidIndex(size_t index);
   bool ShouldRender(BlockId id, glm::ivec3 position, Direction direction);
   bool ShouldRender(BlockId id, glm::ivec3 neighborPos);
+  // like ShouldRender for every block in [min, max) as this chunk is meshed, true if
+  // any of them exposes the face. lets chunks at different lods seal their seams
+  bool ShouldRenderRegion(BlockId id, glm::ivec3 min, glm::ivec3 max);
+  static bool FaceVisible(BlockId id, BlockId neighborId);
   bool HasBlock(glm::ivec3 position);
   BlockId GetBlock(glm::ivec3 position);
   void SetBlock(glm::ivec3 position, BlockId blockId);
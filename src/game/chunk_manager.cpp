@@ -2,6 +2,12 @@
 #include "gen.hpp"
 #include "glm/common.hpp"
 #include "gfx/context.hpp"
+#include "gfx/gpu_culler.hpp"
+#include "dawn/utils/WGPUHelpers.h"
+#include "util/frame_stats.hpp"
+#include "util/profiler.hpp"
+#include <cassert>
+#include <chrono>
 #include <iostream>
 #include <ostream>
 #include <unordered_map>
@@ -11,8 +17,21 @@ namespace game {
 
 using namespace wgpu;
 
+static_assert(1 + gfx::Sun::maxCascades <= util::FrameStats::maxViews);
+
 ChunkManager::ChunkManager(gfx::Context *ctx, GameState *state)
     : m_ctx(ctx), m_state(state) {
+  chunkInfoBuffer =
+    util::CreateStorageBuffer(m_ctx->device, maxChunks * sizeof(ChunkInfo));
+  chunkOriginBuffer =
+    util::CreateUniformBuffer(m_ctx->device, maxChunks * originStride);
+  chunkBindGroup = dawn::utils::MakeBindGroup(
+    m_ctx->device, m_ctx->pipeline.chunkBGL,
+    {
+      {0, chunkOriginBuffer, 0, sizeof(glm::vec3)},
+    }
+  );
+
   const glm::ivec2 centerPos = glm::floor(glm::vec2(0, 0) / glm::vec2(Chunk::SIZE)),
                    minOffset = centerPos - glm::ivec2(radius, radius),
                    maxOffset = centerPos + glm::ivec2(radius, radius);
@@ -20,10 +39,7 @@ ChunkManager::ChunkManager(gfx::Context *ctx, GameState *state)
   for (int x = minOffset.x; x <= maxOffset.x; x++) {
     for (int y = minOffset.y; y <= maxOffset.y; y++) {
       if (glm::distance(glm::vec2(x, y), glm::vec2(centerPos)) > radius - 0.1) continue;
-      const auto offset = glm::ivec2(x, y);
-      auto chunk = new Chunk(m_ctx, m_state, this, offset);
-      GenChunkData(*chunk);
-      chunks.emplace(offset, chunk);
+      AddChunk(glm::ivec2(x, y));
     }
   }
 
@@ -38,6 +54,7 @@ ChunkManager::ChunkManager(gfx::Context *ctx, GameState *state)
 }
 
 void ChunkManager::Update(glm::vec2 position) {
+  PROFILE_ZONE("ChunkManager::Update");
   int gens = 0;
   const glm::ivec2 centerPos = glm::floor(position / glm::vec2(Chunk::SIZE)),
                    minOffset = centerPos - glm::ivec2(radius, radius),
@@ -51,58 +68,93 @@ void ChunkManager::Update(glm::vec2 position) {
   if (!update) goto exit;
 
   // remove chunks not in radius
-  std::erase_if(chunks, [&](auto &pair) {
-    const auto &[offset, chunk] = pair;
-    if (glm::distance(glm::vec2(offset), glm::vec2(centerPos)) > radius - 0.1) {
-      return true;
+  {
+    PROFILE_ZONE("Unload Chunks");
+    if (std::erase_if(chunks, [&](auto &pair) {
+          const auto &[offset, chunk] = pair;
+          if (glm::distance(glm::vec2(offset), glm::vec2(centerPos)) > radius - 0.1) {
+            if (chunk->HasMesh()) MeshChanged(chunk->meshBounds);
+            FreeSlot(chunk->slot);
+            meshVersion++;
+            return true;
+          }
+          return false;
+        })) {
+      m_treeDirty = true;
     }
-    return false;
-  });
+  }
 
   // add chunks in radius
-  for (int x = minOffset.x; x <= maxOffset.x; x++) {
-    for (int y = minOffset.y; y <= maxOffset.y; y++) {
-      if (gens >= max_gens) goto exit;
-      if (glm::distance(glm::vec2(x, y), glm::vec2(centerPos)) > radius - 0.1) continue;
-      const auto offset = glm::ivec2(x, y);
-      if (!chunks.contains(offset)) {
-        auto chunk = new Chunk(m_ctx, m_state, this, offset);
-        GenChunkData(*chunk);
-        chunks.emplace(offset, chunk);
-        for (auto neighbor : GetChunkNeighbors(offset)) {
-          neighbor->dirty = true;
+  {
+    PROFILE_ZONE("Load Chunks");
+    for (int x = minOffset.x; x <= maxOffset.x; x++) {
+      for (int y = minOffset.y; y <= maxOffset.y; y++) {
+        if (gens >= max_gens) goto exit;
+        if (glm::distance(glm::vec2(x, y), glm::vec2(centerPos)) > radius - 0.1) {
+          continue;
+        }
+        const auto offset = glm::ivec2(x, y);
+        if (!chunks.contains(offset)) {
+          AddChunk(offset);
+          m_treeDirty = true;
+          // neighbors only need the border slab facing the new chunk remeshed
+          for (auto dir : {NORTH, SOUTH, EAST, WEST}) {
+            auto neighbor = GetChunk(offset + glm::ivec2(g_DIR_OFFSETS[dir]));
+            if (neighbor) (*neighbor)->dirtyBorders |= 1 << DirOpposite(dir);
+          }
+          gens++;
         }
-        gens++;
       }
     }
   }
 exit:
 
-  if (update) m_state->sun.InvokeUpdate();
-
   if (gens == 0) update = false;
 
-  // store offsets of chunks inside frustum/camera's view
-  m_frustumOffsets.clear();
-  auto frustum = m_state->player.camera.GetFrustum();
-  for (auto &[offset, chunk] : chunks) {
-    auto boundingBox = chunk->GetBoundingBox();
-    if (frustum.Intersects(boundingBox)) {
-      m_frustumOffsets.push_back(offset);
+  if (m_treeDirty) {
+    PROFILE_ZONE("Build Chunk Tree");
+    std::vector<Chunk *> loadedChunks;
+    loadedChunks.reserve(chunks.size());
+    for (auto &[offset, chunk] : chunks) {
+      loadedChunks.push_back(chunk.get());
     }
+    m_chunkTree.Build(loadedChunks);
+    m_treeDirty = false;
+    loadedVersion++;
   }
+
+  // store chunks inside the camera's view and each shadow cascade
+  std::array<util::Frustum, 1 + gfx::Sun::maxCascades> frusta;
+  frusta[0] = m_state->player.camera.GetFrustum();
+  for (int i = 0; i < gfx::Sun::maxCascades; i++) {
+    frusta[1 + i] = m_state->sun.GetFrustum(i);
+  }
+  std::swap(m_culledChunks, m_prevCulledChunks);
+  for (auto &culled : m_culledChunks) culled.clear();
+  {
+    PROFILE_ZONE("Frustum Cull");
+    m_chunkTree.Cull(frusta, m_culledChunks);
+  }
+  // cascades past the sun's count are never drawn
+  for (int i = m_state->sun.GetNumCascades(); i < gfx::Sun::maxCascades; i++) {
+    m_culledChunks[1 + i].clear();
+  }
+  const auto &frustum = frusta[0];
+  CaveCull(frustum);
   // sort front to back for performance
   glm::vec2 pos = glm::vec2(m_state->player.GetPosition()) / glm::vec2(Chunk::SIZE);
-  std::sort(
-    m_frustumOffsets.begin(), m_frustumOffsets.end(),
-    // implicit conversion from ivec2 to vec2
-    [&](glm::vec2 a, glm::vec2 b) {
-      a += glm::vec2(0.5);
-      b += glm::vec2(0.5);
-      return glm::distance(a, pos) < glm::distance(b, pos);
-    }
-  );
-
+  {
+    PROFILE_ZONE("Sort Chunks");
+    std::sort(
+      m_culledChunks[0].begin(), m_culledChunks[0].end(),
+      [&](Chunk *a, Chunk *b) {
+        auto aPos = glm::vec2(a->chunkOffset) + glm::vec2(0.5);
+        auto bPos = glm::vec2(b->chunkOffset) + glm::vec2(0.5);
+        return glm::distance(aPos, pos) < glm::distance(bPos, pos);
+      }
+    );
+  }
+  OcclusionCull();
   // sort offsets back to front based on distance to camera for transparent objects
   /* m_sortedFrustumOffsets = m_frustumOffsets;
   glm::vec2 pos = glm::vec2(m_state->player.GetPosition()) / glm::vec2(Chunk::SIZE);
@@ -116,74 +168,320 @@ exit:
     }
   ); */
 
-  // update dirty chunks
+  UpdateLods(pos);
+  UpdateDirtyChunks(frustum, pos);
+
+  // after remeshing so the facing tests see this frame's bounds
+  uint32_t facingChanged = UpdateFacing();
+  for (size_t i = 0; i < m_culledChunks.size(); i++) {
+    if (m_culledChunks[i] != m_prevCulledChunks[i] || (facingChanged & (1 << i))) {
+      viewVersions[i]++;
+    }
+    util::frameStats.counters.visibleChunks[i] = m_culledChunks[i].size();
+  }
+}
+
+void ChunkManager::UpdateLods(glm::vec2 pos) {
+  PROFILE_ZONE("Update LODs");
+  lodStats = {};
   for (auto &[offset, chunk] : chunks) {
-    if (chunk->dirty) {
-      chunk->UpdateMesh();
-      chunk->dirty = false;
+    int lod = 0;
+    if (lodEnabled) {
+      float dist = glm::distance(glm::vec2(offset) + glm::vec2(0.5), pos);
+      while (lod < Chunk::maxLod && dist > lodRings[lod]) lod++;
+    }
+
+    if (lod != chunk->GetLod()) {
+      chunk->SetLod(lod);
+      // the neighbors' sides facing this chunk were sealed against the old lod
+      for (auto dir : {NORTH, SOUTH, EAST, WEST}) {
+        auto neighbor = GetChunk(offset + glm::ivec2(g_DIR_OFFSETS[dir]));
+        if (neighbor) (*neighbor)->dirtyBorders |= 1 << DirOpposite(dir);
+      }
     }
+
+    auto &stats = lodStats[lod];
+    auto meshStats = chunk->GetMeshStats();
+    stats.chunks++;
+    stats.faces += meshStats.faceNum;
+    stats.bytes += meshStats.bytes;
   }
 }
 
-void ChunkManager::RenderShadowMap(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex, int cascadeLevel
-) {
-  std::vector<glm::ivec2> shadowOffsets;
-  auto frustum = m_state->sun.GetFrustum(cascadeLevel);
+bool ChunkManager::CaveVisit(glm::vec3 eye, const util::Frustum &frustum) {
+  auto lookup = [&](glm::ivec3 section) -> const SectionGraph * {
+    if (section.z < 0 || section.z >= Chunk::numSections) return nullptr;
+    auto chunk = GetChunk(glm::ivec2(section));
+    if (!chunk) return nullptr;
+    return &(*chunk)->sectionGraphs[section.z];
+  };
+  auto visit = [&](glm::ivec3 section) {
+    auto chunk = GetChunk(glm::ivec2(section));
+    (*chunk)->caveVisitFrame = m_caveFrame;
+  };
+
+  m_caveFrame++;
+  return m_caveCuller.Traverse(CaveCuller::SectionOf(eye), frustum, lookup, visit);
+}
+
+void ChunkManager::CaveCull(const util::Frustum &frustum) {
+  PROFILE_ZONE("Cave Cull");
+  caveCulled = 0;
+  if (!caveCulling) return;
+
+  // above the world or outside the loaded chunks, nothing to search from
+  if (!CaveVisit(m_state->player.camera.position, frustum)) return;
+
+  caveCulled = std::erase_if(m_culledChunks[0], [&](Chunk *chunk) {
+    return chunk->caveVisitFrame != m_caveFrame;
+  });
+}
+
+void ChunkManager::OcclusionCull() {
+  PROFILE_ZONE("Occlusion Cull");
+  occlusionCulled = 0;
+  occlusionTime = 0;
+  if (!occlusionCulling) return;
+  auto start = std::chrono::steady_clock::now();
+
+  // the list is sorted front to back, so the nearest chunks are the occluders
+  auto &camera = m_state->player.camera;
+  m_occlusionBuffer.Clear(camera.GetViewProj());
+  int numOccluders = 0;
+  for (auto chunk : m_culledChunks[0]) {
+    if (numOccluders >= maxOccluders) break;
+    if (chunk->occluders.empty()) continue;
+    for (auto &box : chunk->occluders) {
+      m_occlusionBuffer.AddOccluder(box, camera.position);
+    }
+    numOccluders++;
+  }
+
+  // a chunk's own occluders are inside its bounds, so it never hides itself
+  occlusionCulled = std::erase_if(m_culledChunks[0], [&](Chunk *chunk) {
+    return m_occlusionBuffer.IsOccluded(chunk->meshBounds);
+  });
+
+  auto end = std::chrono::steady_clock::now();
+  occlusionTime = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+uint32_t ChunkManager::UpdateFacing() {
+  PROFILE_ZONE("Update Facing");
+  uint32_t changed = 0;
+
+  glm::vec3 eye = m_state->player.camera.position;
+  cameraTriangles = {};
+  for (auto chunk : m_culledChunks[0]) {
+    uint8_t mask = faceCulling ? chunk->FacingDirs(eye) : Chunk::allDirs;
+    if (mask != chunk->cameraDirMask) {
+      chunk->cameraDirMask = mask;
+      changed |= 1;
+    }
+    cameraTriangles.total += chunk->GetFaceCount(Chunk::allDirs) * 2;
+    cameraTriangles.submitted += chunk->GetFaceCount(mask) * 2;
+  }
+
+  // the sun is orthographic, so only the direction matters. faces parallel to it
+  // have no area in the shadow map
+  uint8_t sunMask = Chunk::allDirs;
+  if (faceCulling) {
+    glm::vec3 sunDir = m_state->sun.GetDir();
+    sunMask = 0;
+    for (int dir = 0; dir < 6; dir++) {
+      if (glm::dot(glm::vec3(g_DIR_OFFSETS[dir]), sunDir) > 0) sunMask |= 1 << dir;
+    }
+  }
+  if (sunMask != m_sunDirMask) {
+    m_sunDirMask = sunMask;
+    for (int i = 0; i < gfx::Sun::maxCascades; i++) changed |= 1 << (1 + i);
+  }
+  shadowTriangles = {};
+  for (int i = 0; i < gfx::Sun::maxCascades; i++) {
+    for (auto chunk : m_culledChunks[1 + i]) {
+      shadowTriangles.total += chunk->GetFaceCount(Chunk::allDirs) * 2;
+      shadowTriangles.submitted += chunk->GetFaceCount(sunMask) * 2;
+    }
+  }
+
+  return changed;
+}
+
+void ChunkManager::UpdateDirtyChunks(const util::Frustum &frustum, glm::vec2 pos) {
+  PROFILE_ZONE("Remesh");
+  // visible chunks first, then nearest first
+  const float invisiblePenalty = 1e6;
+  m_remeshQueue.clear();
   for (auto &[offset, chunk] : chunks) {
-    auto boundingBox = chunk->GetBoundingBox();
-    if (frustum.Intersects(boundingBox)) {
-      shadowOffsets.push_back(offset);
+    if (!chunk->dirty && !chunk->dirtyBorders) continue;
+    float priority = glm::distance(glm::vec2(offset) + glm::vec2(0.5), pos);
+    if (!frustum.Intersects(chunk->GetBoundingBox())) priority += invisiblePenalty;
+    m_remeshQueue.push_back({priority, chunk.get()});
+  }
+  std::sort(m_remeshQueue.begin(), m_remeshQueue.end(), [](auto &a, auto &b) {
+    return a.priority < b.priority;
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&]() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration<float, std::milli>(now - start).count();
+  };
+
+  // always remesh at least one chunk so the backlog can't stall
+  size_t numRemeshed = 0;
+  for (auto &item : m_remeshQueue) {
+    if (numRemeshed > 0 && elapsed() >= remeshBudget) break;
+    if (item.chunk->dirty) {
+      item.chunk->UpdateMesh();
+    } else {
+      item.chunk->UpdateBorderMesh(item.chunk->dirtyBorders);
     }
+    item.chunk->dirty = false;
+    item.chunk->dirtyBorders = 0;
+    numRemeshed++;
   }
 
-  for (auto offset : shadowOffsets) {
-    chunks[offset]->Render(passEncoder, groupIndex);
+  remeshBacklog = m_remeshQueue.size() - numRemeshed;
+  if (elapsed() > remeshBudget) remeshOverruns++;
+}
+
+void ChunkManager::RenderShadowMap(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  int cascadeLevel, bool alphaTested
+) {
+  for (auto chunk : m_culledChunks[1 + cascadeLevel]) {
+    chunk->RenderDepth(bundleEncoder, groupIndex, m_sunDirMask, alphaTested);
   }
 }
 
 void ChunkManager::Render(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
   // opaque objects
-  for (auto offset : m_frustumOffsets) {
-    chunks[offset]->Render(passEncoder, groupIndex);
+  for (auto chunk : m_culledChunks[0]) {
+    chunk->Render(bundleEncoder, groupIndex, chunk->cameraDirMask);
   }
 
   // translucent objects
   // for (auto offset : m_sortedFrustumOffsets) {
-  //   chunks[offset]->RenderTranslucent(passEncoder, groupIndex);
+  //   chunks[offset]->RenderTranslucent(bundleEncoder, groupIndex);
   // }
 }
 
+void ChunkManager::RenderDepth(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
+) {
+  for (auto chunk : m_culledChunks[0]) {
+    for (bool alphaTested : {false, true}) {
+      chunk->RenderDepth(bundleEncoder, groupIndex, chunk->cameraDirMask, alphaTested);
+    }
+  }
+}
+
 void ChunkManager::RenderWater(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
-  for (auto offset : m_frustumOffsets) {
-    chunks[offset]->RenderWater(passEncoder, groupIndex);
+  for (auto chunk : m_culledChunks[0]) {
+    chunk->RenderWater(bundleEncoder, groupIndex);
   }
 }
 
 void ChunkManager::RenderWire(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
   // opaque objects
-  for (auto offset : m_frustumOffsets) {
-    chunks[offset]->RenderWire(passEncoder, groupIndex);
+  for (auto chunk : m_culledChunks[0]) {
+    chunk->RenderWire(bundleEncoder, groupIndex);
   }
 
   // translucent objects
   // for (auto offset : m_sortedFrustumOffsets) {
-  //   chunks[offset]->RenderTranslucent(passEncoder, groupIndex);
+  //   chunks[offset]->RenderTranslucent(bundleEncoder, groupIndex);
   // }
 }
 
 void ChunkManager::RenderWaterWire(
-  const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex
 ) {
-  for (auto offset : m_frustumOffsets) {
-    chunks[offset]->RenderWaterWire(passEncoder, groupIndex);
+  for (auto chunk : m_culledChunks[0]) {
+    chunk->RenderWaterWire(bundleEncoder, groupIndex);
+  }
+}
+
+void ChunkManager::RenderIndirect(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  const wgpu::Buffer &indirectBuffer, bool water
+) {
+  for (auto &[chunkOffset, chunk] : chunks) {
+    if (!chunk->HasMesh()) continue;
+    uint64_t offset = chunk->slot * sizeof(gfx::DrawIndexedIndirectArgs);
+    if (water) {
+      chunk->RenderWaterIndirect(bundleEncoder, groupIndex, indirectBuffer, offset);
+    } else {
+      chunk->RenderIndirect(bundleEncoder, groupIndex, indirectBuffer, offset);
+    }
+  }
+}
+
+void ChunkManager::RenderDepthIndirect(
+  const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+  const wgpu::Buffer &indirectBuffer
+) {
+  for (auto &[chunkOffset, chunk] : chunks) {
+    if (!chunk->HasMesh()) continue;
+    uint64_t offset = chunk->slot * sizeof(gfx::DrawIndexedIndirectArgs);
+    chunk->RenderDepthIndirect(bundleEncoder, groupIndex, indirectBuffer, offset);
+  }
+}
+
+void ChunkManager::MeshChanged(const util::AABB &bounds) {
+  m_state->sun.MarkChanged(bounds);
+}
+
+uint32_t ChunkManager::AllocSlot() {
+  if (!m_freeSlots.empty()) {
+    uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return slot;
   }
+  assert(numSlots < maxChunks);
+  return numSlots++;
+}
+
+void ChunkManager::FreeSlot(uint32_t slot) {
+  // zero index counts so the culling pass emits empty draws for the slot
+  ChunkInfo info{};
+  util::WriteBuffer(
+    m_ctx->queue, chunkInfoBuffer, slot * sizeof(ChunkInfo), &info, sizeof(info)
+  );
+  m_freeSlots.push_back(slot);
+}
+
+Chunk *ChunkManager::AddChunk(glm::ivec2 offset) {
+  auto chunk = new Chunk(m_ctx, m_state, this, offset);
+  chunk->slot = AllocSlot();
+  glm::vec3 worldOffset = chunk->GetWorldOffset();
+  util::WriteBuffer(
+    m_ctx->queue, chunkOriginBuffer, chunk->slot * originStride, &worldOffset,
+    sizeof(worldOffset)
+  );
+  GenChunkData(*chunk);
+  chunks.emplace(offset, chunk);
+  return chunk;
+}
+
+void ChunkManager::WriteChunkInfo(Chunk &chunk) {
+  auto bounds = chunk.meshBounds;
+  ChunkInfo info{
+    .boundsMin = bounds.min,
+    .opaqueIndexCount = chunk.GetIndexCount(false),
+    .boundsMax = bounds.max,
+    .waterIndexCount = chunk.GetIndexCount(true),
+  };
+  util::WriteBuffer(
+    m_ctx->queue, chunkInfoBuffer, chunk.slot * sizeof(ChunkInfo), &info, sizeof(info)
+  );
 }
 
 std::optional<Chunk *> ChunkManager::GetChunk(glm::ivec2 offset) {
@@ -229,14 +527,14 @@ std::optional<std::tuple<Chunk *, glm::ivec3>> ChunkManager::GetChunkAndPos(
   return std::make_tuple(it->second.get(), localPos);
 }
 
-// in context when called from a chunk
-bool ChunkManager::ShouldRender(BlockId id, glm::ivec3 position) {
-  auto chunk = GetChunkAndPos(position);
+// in context when called from a chunk, the region never spans two chunks
+bool ChunkManager::ShouldRender(BlockId id, glm::ivec3 min, glm::ivec3 max) {
+  auto chunk = GetChunkAndPos(min);
   if (!chunk) {
     return false;
   }
   auto &[chunkPtr, localPos] = *chunk;
-  return chunkPtr->ShouldRender(id, localPos);
+  return chunkPtr->ShouldRenderRegion(id, localPos, localPos + (max - min));
 }
 
 bool ChunkManager::HasBlock(glm::ivec3 position) {
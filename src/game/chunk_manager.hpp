@@ -1,9 +1,13 @@
 #pragma once
 
 #include "game/chunk.hpp"
+#include "game/cave_culling.hpp"
+#include "game/chunk_tree.hpp"
 #include "glm/ext/vector_float3.hpp"
 #include <glm/gtx/hash.hpp>
 #include "gfx/context.hpp"
+#include "gfx/sun.hpp"
+#include "util/occlusion_buffer.hpp"
 #include <unordered_map>
 #include <vector>
 
@@ -14,34 +18,152 @@ namespace game {
 
 class ChunkManager {
 private:
-  gfx::Context *m_ctx;
-  GameState *m_state;
+  gfx::Context *m_ctx = nullptr;
+  GameState *m_state = nullptr;
 
-  std::vector<glm::ivec2> m_frustumOffsets;
+  ChunkTree m_chunkTree;
+  bool m_treeDirty = true;  // rebuilt when chunks are added or removed
+
+  // culled together, [0] is the camera and [1 + i] is shadow cascade i
+  std::array<std::vector<Chunk *>, 1 + gfx::Sun::maxCascades> m_culledChunks;
+  std::array<std::vector<Chunk *>, 1 + gfx::Sun::maxCascades> m_prevCulledChunks;
   std::vector<glm::ivec2> m_sortedFrustumOffsets;
+  CaveCuller m_caveCuller;
+  uint64_t m_caveFrame = 0;
+  void CaveCull(const util::Frustum &frustum);
+
+  util::OcclusionBuffer m_occlusionBuffer;
+  void OcclusionCull();
+
+  // directions facing the sun, shared by every chunk in the cascades
+  uint8_t m_sunDirMask = Chunk::allDirs;
 
   glm::vec2 m_prevPos;
 
+  struct RemeshItem {
+    float priority;  // lower is remeshed first
+    Chunk *chunk;
+  };
+  std::vector<RemeshItem> m_remeshQueue;
+
+  void UpdateDirtyChunks(const util::Frustum &frustum, glm::vec2 pos);
+  // pos in chunks, remeshes chunks that crossed a ring along with their neighbors
+  void UpdateLods(glm::vec2 pos);
+  // returns which views' recorded draws changed, bit 0 camera and 1 + i cascades
+  uint32_t UpdateFacing();
+
+  // slots index the per-chunk gpu buffers, freed slots are reused
+  std::vector<uint32_t> m_freeSlots;
+  uint32_t AllocSlot();
+  void FreeSlot(uint32_t slot);
+  Chunk *AddChunk(glm::ivec2 offset);
+
 public:
   bool update = true;
 
   int radius = 32;
   int max_gens = 4;
+
+  // time allowed per frame for remeshing dirty chunks, leftovers carry over
+  float remeshBudget = 4.0;  // ms
+  size_t remeshBacklog = 0;
+  size_t remeshOverruns = 0;
   std::unordered_map<glm::ivec2, std::unique_ptr<Chunk>> chunks;
 
+  // skip direction buckets facing away from the camera or the sun
+  bool faceCulling = true;
+  struct TriangleStats {
+    size_t total; // in the culled chunks
+    size_t submitted; // after face culling
+  };
+  TriangleStats cameraTriangles{};
+  TriangleStats shadowTriangles{}; // all cascades
+
+  // drop camera chunks that can't be seen through connected sections, see CaveCuller
+  bool caveCulling = true;
+  size_t caveCulled = 0; // chunks in the frustum, this frame
+  // sets caveVisitFrame of every chunk the search from eye reaches to a new frame.
+  // false if eye isn't in a loaded section. used by the cave culling, and
+  // check_cave_cull runs it on hand-built chunks
+  bool CaveVisit(glm::vec3 eye, const util::Frustum &frustum);
+
+  // chunks past each ring (distance in chunks) mesh at the next lod, see Chunk::SetLod
+  bool lodEnabled = true;
+  std::array<int, Chunk::maxLod> lodRings = {12, 24};
+  struct LodStats {
+    size_t chunks;
+    size_t faces;
+    size_t bytes; // see Chunk::MeshStats
+  };
+  std::array<LodStats, 1 + Chunk::maxLod> lodStats{};
+
+  // rasterize the solid boxes of the nearest chunks on the cpu and drop camera chunks
+  // behind them, see util::OcclusionBuffer
+  bool occlusionCulling = true;
+  int maxOccluders = 128;
+  size_t occlusionCulled = 0; // chunks, this frame
+  float occlusionTime = 0; // ms, this frame
+
+  // enough for the max radius of 64 (~12.9k chunks)
+  static constexpr uint32_t maxChunks = 16384;
+  // per slot data read by the gpu culling pass
+  struct ChunkInfo {
+    glm::vec3 boundsMin;
+    uint32_t opaqueIndexCount;
+    glm::vec3 boundsMax;
+    uint32_t waterIndexCount;
+  };
+  wgpu::Buffer chunkInfoBuffer;
+  uint32_t numSlots = 0; // slots in use are below this
+
+  // world origin of every slot, bound once with a dynamic offset per chunk
+  static constexpr uint32_t originStride = 256; // minUniformBufferOffsetAlignment
+  wgpu::Buffer chunkOriginBuffer;
+  wgpu::BindGroup chunkBindGroup;
+
+  // draw lists recorded into render bundles stay valid until these change
+  uint64_t meshVersion = 0; // chunk uploaded or unloaded
+  uint64_t loadedVersion = 0; // chunk added or removed
+  // per culled view (camera, then cascades), visible set or order changed
+  std::array<uint64_t, 1 + gfx::Sun::maxCascades> viewVersions{};
+
   ChunkManager() = default;
   ChunkManager(gfx::Context *ctx, GameState *state);
   void Update(glm::vec2 position);
-  void RenderShadowMap(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex, int cascadeLevel);
-  void Render(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderWater(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderWire(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
-  void RenderWaterWire(const wgpu::RenderPassEncoder &passEncoder, uint32_t groupIndex);
+  // depth meshes, drawn once with the plain shadow pipeline and once with the alpha
+  // tested one, see Chunk::RenderDepth
+  void RenderShadowMap(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    int cascadeLevel, bool alphaTested
+  );
+  void Render(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  // every depth mesh face of the camera chunks, for the depth prepass
+  void RenderDepth(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  void RenderWater(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  void RenderWire(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  void RenderWaterWire(const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex);
+  // draws every loaded chunk with args written by the gpu culling pass, ignores the
+  // cpu culling results
+  void RenderIndirect(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    const wgpu::Buffer &indirectBuffer, bool water = false
+  );
+  void RenderDepthIndirect(
+    const wgpu::RenderBundleEncoder &bundleEncoder, uint32_t groupIndex,
+    const wgpu::Buffer &indirectBuffer
+  );
+  void WriteChunkInfo(Chunk &chunk);
+  // geometry inside bounds was added or removed, redraws the shadow cascades over it
+  void MeshChanged(const util::AABB &bounds);
+  size_t CulledCount(size_t view) {
+    return m_culledChunks[view].size();
+  }
 
   std::optional<Chunk *> GetChunk(glm::ivec2 offset);
   std::vector<Chunk *> GetChunkNeighbors(glm::ivec2 offset);
   std::optional<std::tuple<Chunk *, glm::ivec3>> GetChunkAndPos(glm::ivec3 position);
-  bool ShouldRender(BlockId id, glm::ivec3 position);
+  // region is world space with max exclusive, see Chunk::ShouldRenderRegion
+  bool ShouldRender(BlockId id, glm::ivec3 min, glm::ivec3 max);
   bool HasBlock(glm::ivec3 position);
   void SetBlockAndUpdate(glm::ivec3 position, BlockId blockId);
 };
@@ -0,0 +1,169 @@
+#include "chunk_tree.hpp"
+#include "chunk.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace game {
+
+// interleave the bits of x and y, so sorting by key sorts by quadtree node
+static uint32_t MortonKey(glm::uvec2 pos) {
+  auto spread = [](uint32_t v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  };
+  return spread(pos.x) | (spread(pos.y) << 1);
+}
+
+static util::AABB Merge(const util::AABB &a, const util::AABB &b) {
+  return util::AABB{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+void ChunkTree::Build(const std::vector<Chunk *> &chunks) {
+  m_nodes.clear();
+  m_chunks.clear();
+  m_bounds.Clear();
+  m_keys.clear();
+  if (chunks.empty()) return;
+
+  glm::ivec2 minOffset = chunks[0]->chunkOffset;
+  glm::ivec2 maxOffset = minOffset;
+  for (auto chunk : chunks) {
+    minOffset = glm::min(minOffset, chunk->chunkOffset);
+    maxOffset = glm::max(maxOffset, chunk->chunkOffset);
+  }
+
+  std::vector<std::pair<uint32_t, Chunk *>> sorted;
+  sorted.reserve(chunks.size());
+  for (auto chunk : chunks) {
+    sorted.emplace_back(MortonKey(chunk->chunkOffset - minOffset), chunk);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) {
+    return a.first < b.first;
+  });
+
+  m_bounds.Reserve(sorted.size());
+  for (auto &[key, chunk] : sorted) {
+    m_keys.push_back(key);
+    m_chunks.push_back(chunk);
+    m_bounds.Push(chunk->GetBoundingBox());
+  }
+
+  // depth of the tree, enough bits per axis to cover every offset
+  auto extent = glm::max(maxOffset.x - minOffset.x, maxOffset.y - minOffset.y);
+  int bits = 0;
+  while ((1 << bits) <= extent) bits++;
+
+  m_nodes.reserve(m_chunks.size() / maxLeafSize * 2 + 1);
+  BuildNode(0, m_chunks.size(), bits * 2);
+}
+
+int32_t ChunkTree::BuildNode(uint32_t first, uint32_t count, int shift) {
+  int32_t index = m_nodes.size();
+  m_nodes.push_back(Node{
+    .first = first,
+    .count = count,
+    .children = {-1, -1, -1, -1},
+    .leaf = count <= maxLeafSize || shift == 0,
+  });
+
+  util::AABB box = m_bounds.Get(first);
+  if (m_nodes[index].leaf) {
+    for (uint32_t i = first; i < first + count; i++) {
+      box = Merge(box, m_bounds.Get(i));
+    }
+  } else {
+    // keys share their upper bits within a node, split the range by the next 2 bits
+    std::array<int32_t, 4> children = {-1, -1, -1, -1};
+    uint32_t begin = first;
+    uint32_t end = first + count;
+    for (uint32_t quadrant = 0; quadrant < 4; quadrant++) {
+      uint32_t split = begin;
+      while (split < end && ((m_keys[split] >> (shift - 2)) & 3) == quadrant) split++;
+      if (split > begin) {
+        children[quadrant] = BuildNode(begin, split - begin, shift - 2);
+        box = Merge(box, m_nodes[children[quadrant]].box);
+      }
+      begin = split;
+    }
+    m_nodes[index].children = children;
+  }
+  m_nodes[index].box = box;
+
+  return index;
+}
+
+void ChunkTree::Cull(const util::Frustum &frustum, std::vector<Chunk *> &visible) const {
+  Cull(std::span(&frustum, 1), std::span(&visible, 1));
+}
+
+void ChunkTree::Cull(
+  std::span<const util::Frustum> frusta, std::span<std::vector<Chunk *>> visible
+) const {
+  assert(frusta.size() <= 8 && frusta.size() == visible.size());
+  if (m_nodes.empty()) return;
+  CullNode(m_nodes[0], frusta, visible, (1 << frusta.size()) - 1);
+}
+
+void ChunkTree::CullNode(
+  const Node &node, std::span<const util::Frustum> frusta,
+  std::span<std::vector<Chunk *>> visible, uint8_t active
+) const {
+  uint8_t intersecting = 0;
+  for (size_t f = 0; f < frusta.size(); f++) {
+    if (!(active & (1 << f))) continue;
+    switch (frusta[f].Classify(node.box)) {
+    case util::Frustum::Containment::Outside:
+      break;
+    case util::Frustum::Containment::Inside:
+      // accept the whole subtree without testing it
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (m_chunks[i]->HasMesh()) visible[f].push_back(m_chunks[i]);
+      }
+      break;
+    case util::Frustum::Containment::Intersects:
+      intersecting |= 1 << f;
+      break;
+    }
+  }
+  if (!intersecting) return;
+
+  if (node.leaf) {
+    // only test the frusta that cut through this leaf
+    std::array<util::Frustum, 8> subset;
+    std::array<uint8_t, 8> subsetIndex;
+    size_t subsetSize = 0;
+    for (size_t f = 0; f < frusta.size(); f++) {
+      if (!(intersecting & (1 << f))) continue;
+      subsetIndex[subsetSize] = f;
+      subset[subsetSize++] = frusta[f];
+    }
+
+    std::array<uint8_t, maxLeafSize> masks;
+    for (uint32_t first = node.first; first < node.first + node.count;
+         first += maxLeafSize) {
+      uint32_t count = std::min(maxLeafSize, node.first + node.count - first);
+      util::IntersectsBatch(
+        std::span(subset.data(), subsetSize), m_bounds, first, count, masks.data()
+      );
+      for (uint32_t i = 0; i < count; i++) {
+        if (!masks[i] || !m_chunks[first + i]->HasMesh()) continue;
+        for (size_t s = 0; s < subsetSize; s++) {
+          if (!(masks[i] & (1 << s))) continue;
+          visible[subsetIndex[s]].push_back(m_chunks[first + i]);
+        }
+      }
+    }
+    return;
+  }
+
+  for (auto child : node.children) {
+    if (child != -1) CullNode(m_nodes[child], frusta, visible, intersecting);
+  }
+}
+
+} // namespace game
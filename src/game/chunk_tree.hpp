@@ -0,0 +1,53 @@
+#pragma once
+
+#include "glm/ext/vector_int2.hpp"
+#include "util/frustum.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace game {
+
+class Chunk; // forward dec
+
+// quadtree over chunk offsets, each node stores the merged bounding box of its
+// subtree so whole subtrees are accepted or rejected with a single frustum test.
+// built once per change of the loaded chunk set and shared by the camera and every
+// shadow cascade, which are all culled in the same traversal
+class ChunkTree {
+private:
+  static constexpr uint32_t maxLeafSize = 8;
+
+  struct Node {
+    util::AABB box;
+    // subtrees are contiguous in m_chunks (morton order)
+    uint32_t first;
+    uint32_t count;
+    std::array<int32_t, 4> children; // -1 if empty
+    bool leaf;
+  };
+
+  std::vector<Node> m_nodes;
+  std::vector<Chunk *> m_chunks;
+  util::AABBSoA m_bounds; // leaves are tested in batches, see util::IntersectsBatch
+  std::vector<uint32_t> m_keys;
+
+  int32_t BuildNode(uint32_t first, uint32_t count, int shift);
+  // active has a bit per frustum that still partially overlaps the parent
+  void CullNode(
+    const Node &node, std::span<const util::Frustum> frusta,
+    std::span<std::vector<Chunk *>> visible, uint8_t active
+  ) const;
+
+public:
+  void Build(const std::vector<Chunk *> &chunks);
+  // appends chunks with a mesh that intersect the frustum
+  void Cull(const util::Frustum &frustum, std::vector<Chunk *> &visible) const;
+  // culls against up to 8 frusta at once, visible[f] gets the chunks for frusta[f]
+  void Cull(
+    std::span<const util::Frustum> frusta, std::span<std::vector<Chunk *>> visible
+  ) const;
+};
+
+} // namespace game
@@ -0,0 +1,189 @@
+#include "far_terrain.hpp"
+#include "game/chunk.hpp"
+#include "game/gen.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/vector_relational.hpp"
+#include "util/frame_stats.hpp"
+#include "util/webgpu-util.hpp"
+#include "game.hpp"
+#include <algorithm>
+
+namespace game {
+
+using namespace wgpu;
+
+static_assert(FarTerrain::baseSpacing == Chunk::SIZE.x && Chunk::SIZE.x == Chunk::SIZE.y);
+
+static constexpr int gridVerts = FarTerrain::gridSize + 1;
+
+FarTerrain::FarTerrain(gfx::Context *ctx, GameState *state)
+    : m_ctx(ctx), m_state(state) {
+  for (int i = 0; i < numLevels; i++) {
+    auto &level = m_levels[i];
+    level.spacing = baseSpacing << i;
+    level.vbo =
+      util::CreateVertexBuffer(m_ctx->device, gridVerts * gridVerts * sizeof(Vertex));
+    level.ebo = util::CreateIndexBuffer(
+      m_ctx->device, gridSize * gridSize * 6 * sizeof(uint32_t)
+    );
+  }
+}
+
+void FarTerrain::Update() {
+  if (!enabled) return;
+  glm::vec2 pos = m_state->player.GetPosition();
+
+  bool resampled = false;
+  for (auto &level : m_levels) {
+    float snap = level.spacing * 2;
+    glm::ivec2 center = glm::ivec2(glm::floor(pos / snap)) * (level.spacing * 2);
+    if (!level.sampled) {
+      Sample(level, center);
+    } else if (center != level.center && !resampled) {
+      Sample(level, center);
+      resampled = true;
+    }
+  }
+
+  triangles = 0;
+  for (int i = 0; i < numLevels; i++) {
+    Level::HoleKey key{
+      .loadedVersion = m_state->chunkManager.loadedVersion,
+      .innerCenter = i > 0 ? m_levels[i - 1].center : glm::ivec2(0),
+    };
+    if (!m_levels[i].indexed || !(m_levels[i].holeKey == key)) BuildIndices(i, key);
+    triangles += m_levels[i].indexCount / 3;
+  }
+}
+
+void FarTerrain::Sample(Level &level, glm::ivec2 center) {
+  level.center = center;
+  level.sampled = true;
+  level.indexed = false;
+
+  auto index = [](int i, int j) { return i + j * gridVerts; };
+  auto origin = level.Origin();
+  level.heights.resize(gridVerts * gridVerts);
+  level.vertices.resize(gridVerts * gridVerts);
+  for (int j = 0; j < gridVerts; j++) {
+    for (int i = 0; i < gridVerts; i++) {
+      auto column = SampleTerrain(origin + glm::ivec2(i, j) * level.spacing);
+      // top face of the top block, or of the water above it
+      level.heights[index(i, j)] = std::max(column.height, WATER_LEVEL) + 1 - sink;
+
+      glm::vec3 color;
+      switch (column.biome) {
+      case Ocean:
+        color = glm::vec3(0.16, 0.33, 0.64);
+        break;
+      case Beach:
+        color = glm::vec3(0.86, 0.81, 0.58);
+        break;
+      case Plains:
+      default:
+        color = glm::vec3(0.36, 0.6, 0.25);
+        break;
+      }
+      level.vertices[index(i, j)].color = color;
+    }
+  }
+
+  // odd vertices on the outer edge lie on an edge of the coarser level, pin them to
+  // it so the rings don't crack
+  auto &heights = level.heights;
+  for (int k = 1; k < gridSize; k += 2) {
+    for (int edge : {0, gridSize}) {
+      heights[index(k, edge)] =
+        (heights[index(k - 1, edge)] + heights[index(k + 1, edge)]) / 2;
+      heights[index(edge, k)] =
+        (heights[index(edge, k - 1)] + heights[index(edge, k + 1)]) / 2;
+    }
+  }
+
+  for (int j = 0; j < gridVerts; j++) {
+    for (int i = 0; i < gridVerts; i++) {
+      int i0 = std::max(i - 1, 0), i1 = std::min(i + 1, gridSize);
+      int j0 = std::max(j - 1, 0), j1 = std::min(j + 1, gridSize);
+      float dx = (heights[index(i1, j)] - heights[index(i0, j)]) /
+                 ((i1 - i0) * level.spacing);
+      float dy = (heights[index(i, j1)] - heights[index(i, j0)]) /
+                 ((j1 - j0) * level.spacing);
+
+      auto &vertex = level.vertices[index(i, j)];
+      glm::vec2 xy = origin + glm::ivec2(i, j) * level.spacing;
+      vertex.position = glm::vec3(xy, heights[index(i, j)]);
+      vertex.normal = glm::normalize(glm::vec3(-dx, -dy, 1));
+    }
+  }
+
+  util::WriteBuffer(
+    m_ctx->queue, level.vbo, 0, level.vertices.data(),
+    level.vertices.size() * sizeof(Vertex)
+  );
+}
+
+void FarTerrain::BuildIndices(int levelIndex, Level::HoleKey key) {
+  auto &level = m_levels[levelIndex];
+  level.holeKey = key;
+  level.indexed = true;
+  level.indices.clear();
+
+  // area drawn by the finer level
+  bool hasInner = levelIndex > 0 && m_levels[levelIndex - 1].sampled;
+  glm::ivec2 innerMin(0), innerMax(0);
+  if (hasInner) {
+    auto &inner = m_levels[levelIndex - 1];
+    innerMin = inner.Origin();
+    innerMax = innerMin + gridSize * inner.spacing;
+  }
+
+  auto &chunkManager = m_state->chunkManager;
+  int chunksPerCell = level.spacing / baseSpacing;
+  auto origin = level.Origin();
+  for (int j = 0; j < gridSize; j++) {
+    for (int i = 0; i < gridSize; i++) {
+      glm::ivec2 cellMin = origin + glm::ivec2(i, j) * level.spacing;
+      glm::ivec2 cellMax = cellMin + level.spacing;
+      if (hasInner && glm::all(glm::greaterThanEqual(cellMin, innerMin)) &&
+          glm::all(glm::lessThanEqual(cellMax, innerMax))) {
+        continue;
+      }
+
+      // covered once every chunk under the cell is loaded, cells are chunk aligned
+      bool covered = true;
+      glm::ivec2 firstChunk = cellMin / baseSpacing;
+      for (int y = 0; covered && y < chunksPerCell; y++) {
+        for (int x = 0; covered && x < chunksPerCell; x++) {
+          covered = chunkManager.chunks.contains(firstChunk + glm::ivec2(x, y));
+        }
+      }
+      if (covered) continue;
+
+      uint32_t a = i + j * gridVerts, b = a + 1;
+      uint32_t c = b + gridVerts, d = a + gridVerts;
+      level.indices.insert(level.indices.end(), {a, b, c, a, c, d});
+    }
+  }
+
+  level.indexCount = level.indices.size();
+  if (level.indexCount > 0) {
+    util::WriteBuffer(
+      m_ctx->queue, level.ebo, 0, level.indices.data(),
+      level.indices.size() * sizeof(uint32_t)
+    );
+  }
+}
+
+void FarTerrain::Render(const wgpu::RenderPassEncoder &passEncoder) {
+  if (!enabled) return;
+  for (auto &level : m_levels) {
+    if (level.indexCount == 0) continue;
+    passEncoder.SetVertexBuffer(0, level.vbo, 0, level.vbo.GetSize());
+    passEncoder.SetIndexBuffer(level.ebo, IndexFormat::Uint32, 0, level.ebo.GetSize());
+    passEncoder.DrawIndexed(level.indexCount);
+    util::frameStats.drawsEncoded++;
+  }
+}
+
+} // namespace game
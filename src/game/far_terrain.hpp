@@ -0,0 +1,80 @@
+#pragma once
+
+#include "glm/ext/vector_float3.hpp"
+#include "glm/ext/vector_int2.hpp"
+#include "gfx/context.hpp"
+#include <webgpu/webgpu_cpp.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// forward decl
+struct GameState;
+
+namespace game {
+
+// the generator's surface beyond the chunk radius, as heightfield clipmap rings that
+// double in spacing. every level follows the player on its own and is resampled only
+// when its snapped center moves, so the coarse rings rarely change. cells already
+// covered by loaded chunks or by the finer level are left out of the index buffer.
+// only drawn into the g-buffer, it casts no shadows
+class FarTerrain {
+public:
+  static constexpr int numLevels = 3;
+  static constexpr int gridSize = 64; // cells per side
+  static constexpr int baseSpacing = 16; // one chunk
+
+  struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 color;
+  };
+
+private:
+  gfx::Context *m_ctx;
+  GameState *m_state;
+
+  struct Level {
+    int spacing;
+    glm::ivec2 center; // multiple of 2 * spacing, so levels share cell edges
+    bool sampled = false;
+    std::vector<float> heights; // (gridSize + 1)^2
+    std::vector<Vertex> vertices;
+    wgpu::Buffer vbo;
+
+    // cells outside the hole, rebuilt when the hole or the samples change
+    struct HoleKey {
+      uint64_t loadedVersion; // see ChunkManager
+      glm::ivec2 innerCenter;
+      bool operator==(const HoleKey &) const = default;
+    };
+    HoleKey holeKey;
+    bool indexed = false;
+    std::vector<uint32_t> indices;
+    wgpu::Buffer ebo;
+    uint32_t indexCount = 0;
+
+    glm::ivec2 Origin() const {
+      return center - gridSize / 2 * spacing;
+    }
+  };
+  std::array<Level, numLevels> m_levels;
+  // lowered so the voxel surface wins where the two overlap
+  static constexpr float sink = 1.0; // blocks
+
+  void Sample(Level &level, glm::ivec2 center);
+  void BuildIndices(int levelIndex, Level::HoleKey key);
+
+public:
+  bool enabled = true;
+  size_t triangles = 0;
+
+  FarTerrain() = default;
+  FarTerrain(gfx::Context *ctx, GameState *state);
+  // resamples at most one level per frame
+  void Update();
+  // pipeline and camera must be bound
+  void Render(const wgpu::RenderPassEncoder &passEncoder);
+};
+
+} // namespace game
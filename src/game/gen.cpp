@@ -6,6 +6,8 @@
 #include "PerlinNoise.hpp"
 #include "game/block.hpp"
 #include "glm/gtx/norm.hpp"
+#include "util/frame_stats.hpp"
+#include "util/profiler.hpp"
 
 namespace game {
 
@@ -13,6 +15,8 @@ void GenTest(Chunk &chunk);
 void GenTerrain(Chunk &chunk);
 
 void GenChunkData(Chunk &chunk) {
+  PROFILE_ZONE("GenChunkData");
+  util::frameStats.counters.chunksGenerated++;
   GenTerrain(chunk);
   // GenTest(chunk);
 }
@@ -37,13 +41,6 @@ void GenTest(Chunk &chunk) {
   }
 }
 
-enum Biome {
-  Ocean,
-  Beach,
-  Plains,
-};
-constexpr int WATER_LEVEL = 64;
-
 void SetBlock(Chunk &chunk, glm::ivec3 pos, BlockId blockId) {
   if (pos.z < 0 || pos.z >= Chunk::SIZE.z) {
     return;
@@ -106,12 +103,29 @@ void Tree(Chunk &chunk, glm::ivec3 rootPos) {
   }
 }
 
+TerrainColumn SampleTerrain(glm::ivec2 xyWorld) {
+  static const siv::PerlinNoise::seed_type seed = 20;
+  static const siv::PerlinNoise biomeNoise{seed};
+
+  float spread = 150.0;
+  int height =
+    28 + biomeNoise.octave2D_01(xyWorld.x / spread, xyWorld.y / spread, 4) * 99;
+
+  Biome biome;
+  if (height < WATER_LEVEL) {
+    biome = Ocean;
+  } else if (height < WATER_LEVEL + 4) {
+    biome = Beach;
+  } else {
+    biome = Plains;
+  }
+  return {height, biome};
+}
+
 void GenTerrain(Chunk &chunk) {
   auto &data = chunk.GetBlockIdData();
   chunk.outOfBoundLeafPositions.clear();
 
-  static const siv::PerlinNoise::seed_type seed = 20;
-  static const siv::PerlinNoise biomeNoise{seed};
   static const siv::PerlinNoise topLayerNoise{10};
   static const siv::PerlinNoise treeGen{10};
 
@@ -120,24 +134,13 @@ void GenTerrain(Chunk &chunk) {
     for (int y = 0; y < Chunk::SIZE.y; y++) {
       auto xyWorld = glm::ivec2(x, y) + glm::ivec2(worldOffset);
 
-      float spread = 150.0;
-      int height =
-        28 + biomeNoise.octave2D_01(xyWorld.x / spread, xyWorld.y / spread, 4) * 99;
+      auto [height, biome] = SampleTerrain(xyWorld);
       int topDepth =
         2 + topLayerNoise.octave2D_01(xyWorld.x / 10.0, xyWorld.y / 10.0, 4) * 6;
       int topHeight = height - topDepth;
 
       float treeChance = treeGen.octave2D_01(xyWorld.x, xyWorld.y, 4);
 
-      Biome biome;
-      if (height < WATER_LEVEL) {
-        biome = Ocean;
-      } else if (height < WATER_LEVEL + 4) {
-        biome = Beach;
-      } else {
-        biome = Plains;
-      }
-
       BlockId topBlock;
       BlockId centerBlock = BlockId::Stone;
       switch (biome) {
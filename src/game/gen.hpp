@@ -1,7 +1,25 @@
+#pragma once
+
+#include "glm/ext/vector_int2.hpp"
+
 namespace game {
 
 class Chunk; // forward dec
 
+enum Biome {
+  Ocean,
+  Beach,
+  Plains,
+};
+constexpr int WATER_LEVEL = 64;
+
+// surface of one world column, before trees
+struct TerrainColumn {
+  int height; // z of the top block
+  Biome biome;
+};
+TerrainColumn SampleTerrain(glm::ivec2 xyWorld);
+
 void GenChunkData(Chunk &chunk);
 
 } // namespace game
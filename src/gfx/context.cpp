@@ -5,6 +5,7 @@
 #include <dawn/utils/TextureUtils.h>
 
 #include <iostream>
+#include <vector>
 
 namespace gfx {
 
@@ -37,8 +38,15 @@ Context::Context(GLFWwindow *window, glm::uvec2 size) {
     .limits = supportedLimits.limits,
   };
 
+  // optional features, used if the adapter has them
+  std::vector<FeatureName> requiredFeatures;
+  timestampQueries = adapter.HasFeature(FeatureName::TimestampQuery);
+  if (timestampQueries) requiredFeatures.push_back(FeatureName::TimestampQuery);
+
   // device
   DeviceDescriptor deviceDesc{
+    .requiredFeatureCount = requiredFeatures.size(),
+    .requiredFeatures = requiredFeatures.data(),
     .requiredLimits = &requiredLimits,
   };
   device = util::RequestDevice(adapter, &deviceDesc);
@@ -49,7 +57,8 @@ Context::Context(GLFWwindow *window, glm::uvec2 size) {
 
   // swap chain format
   swapChainFormat = TextureFormat::BGRA8Unorm;
-  depthFormat = TextureFormat::Depth24Plus;
+  // copyable, the compact gbuffer reads a copy of it
+  depthFormat = TextureFormat::Depth32Float;
 
   // swap chain
   SwapChainDescriptor swapChainDesc{
@@ -64,4 +73,40 @@ Context::Context(GLFWwindow *window, glm::uvec2 size) {
   pipeline = gfx::Pipeline(*this);
 }
 
+Context::Context(bool forceFallback) {
+  instance = CreateInstance();
+  if (!instance) {
+    std::cerr << "Could not initialize WebGPU!" << std::endl;
+    std::exit(1);
+  }
+
+  RequestAdapterOptions adapterOpts{
+    .powerPreference = PowerPreference::HighPerformance,
+    .forceFallbackAdapter = forceFallback,
+  };
+  adapter = util::RequestAdapter(instance, &adapterOpts);
+  if (!adapter) {
+    std::cerr << "No WebGPU adapter" << std::endl;
+    std::exit(1);
+  }
+
+  SupportedLimits supportedLimits;
+  adapter.GetLimits(&supportedLimits);
+  RequiredLimits requiredLimits{
+    .limits = supportedLimits.limits,
+  };
+  DeviceDescriptor deviceDesc{
+    .requiredLimits = &requiredLimits,
+  };
+  device = util::RequestDevice(adapter, &deviceDesc);
+  util::SetUncapturedErrorCallback(device);
+  queue = device.GetQueue();
+
+  // the pipelines are built for these even though nothing is presented
+  swapChainFormat = TextureFormat::BGRA8Unorm;
+  depthFormat = TextureFormat::Depth32Float;
+
+  pipeline = gfx::Pipeline(*this);
+}
+
 } // namespace gfx
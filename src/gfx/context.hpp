@@ -18,11 +18,16 @@ struct Context {
 
   wgpu::TextureFormat swapChainFormat;
   wgpu::TextureFormat depthFormat;
+  // the device has FeatureName::TimestampQuery, see GpuTimer
+  bool timestampQueries = false;
 
   gfx::Pipeline pipeline;
 
   Context() = default;
   Context(GLFWwindow *window, glm::uvec2 size);
+  // no window or swap chain, for the headless tools. forceFallback asks for the
+  // software adapter (SwiftShader) so they also run without a gpu
+  explicit Context(bool forceFallback);
 };
 
 } // namespace gfx
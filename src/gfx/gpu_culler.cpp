@@ -0,0 +1,190 @@
+#include "gpu_culler.hpp"
+
+#include "dawn/utils/WGPUHelpers.h"
+#include "glm/common.hpp"
+#include "game.hpp"
+#include "util/webgpu-util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gfx {
+
+using namespace wgpu;
+
+GpuCuller::GpuCuller(
+  gfx::Context *ctx, GameState *state, TextureView depthView, glm::uvec2 depthSize
+)
+    : m_ctx(ctx), m_state(state), m_hizSize(depthSize) {
+  // indirect args and counts ---------------------------------------
+  auto argsSize = game::ChunkManager::maxChunks * sizeof(DrawIndexedIndirectArgs);
+  auto argsUsage = BufferUsage::Storage | BufferUsage::Indirect;
+  for (size_t i = 0; i < numViews; i++) {
+    opaqueArgs[i] = util::CreateBuffer(m_ctx->device, argsUsage, argsSize);
+    waterArgs[i] = util::CreateBuffer(m_ctx->device, argsUsage, argsSize);
+  }
+
+  m_countsBuffer = util::CreateBuffer(
+    m_ctx->device, BufferUsage::Storage | BufferUsage::CopySrc, numViews * countsStride
+  );
+  m_readbackBuffer =
+    util::CreateBuffer(m_ctx->device, BufferUsage::MapRead, numViews * countsStride);
+
+  // hi-z -------------------------------------------------------------
+  uint32_t mipLevelCount =
+    std::floor(std::log2(std::max(depthSize.x, depthSize.y))) + 1;
+  Texture hizTexture = m_ctx->device.CreateTexture(ToPtr(TextureDescriptor{
+    .usage = TextureUsage::StorageBinding | TextureUsage::TextureBinding,
+    .size = {depthSize.x, depthSize.y, 1},
+    .format = TextureFormat::R32Float,
+    .mipLevelCount = mipLevelCount,
+  }));
+  auto mipView = [&](uint32_t level) {
+    return hizTexture.CreateView(ToPtr(TextureViewDescriptor{
+      .baseMipLevel = level,
+      .mipLevelCount = 1,
+    }));
+  };
+
+  m_hizInitBindGroup = dawn::utils::MakeBindGroup(
+    m_ctx->device, m_ctx->pipeline.hizInitBGL,
+    {
+      {0, depthView},
+      {2, mipView(0)},
+    }
+  );
+  m_hizMipSizes.push_back(depthSize);
+  for (uint32_t level = 1; level < mipLevelCount; level++) {
+    m_hizDownsampleBindGroups.push_back(dawn::utils::MakeBindGroup(
+      m_ctx->device, m_ctx->pipeline.hizDownsampleBGL,
+      {
+        {1, mipView(level - 1)},
+        {2, mipView(level)},
+      }
+    ));
+    m_hizMipSizes.push_back(glm::max(depthSize >> level, glm::uvec2(1)));
+  }
+
+  // cull bind groups, one per view -----------------------------------
+  TextureView hizView = hizTexture.CreateView();
+  for (size_t i = 0; i < numViews; i++) {
+    m_paramsBuffers[i] = util::CreateUniformBuffer(m_ctx->device, sizeof(CullParams));
+    m_cullBindGroups[i] = dawn::utils::MakeBindGroup(
+      m_ctx->device, m_ctx->pipeline.cullBGL,
+      {
+        {0, m_paramsBuffers[i]},
+        {1, m_state->chunkManager.chunkInfoBuffer},
+        {2, opaqueArgs[i]},
+        {3, waterArgs[i]},
+        {4, m_countsBuffer, i * countsStride, sizeof(DrawCounts)},
+        {5, hizView},
+      }
+    );
+  }
+}
+
+void GpuCuller::Cull(
+  const CommandEncoder &commandEncoder,
+  const ComputePassTimestampWrites *timestampWrites
+) {
+  std::array<util::Frustum, numViews> frusta;
+  frusta[0] = m_state->player.camera.GetFrustum();
+  for (int i = 0; i < Sun::maxCascades; i++) {
+    frusta[1 + i] = m_state->sun.GetFrustum(i);
+  }
+  Cull(commandEncoder, frusta, timestampWrites);
+}
+
+void GpuCuller::Cull(
+  const CommandEncoder &commandEncoder,
+  const std::array<util::Frustum, numViews> &frusta,
+  const ComputePassTimestampWrites *timestampWrites
+) {
+  auto numChunks = m_state->chunkManager.numSlots;
+
+  // only the camera view has a matching depth buffer
+  bool useHiz = occlusion && m_hizValid;
+  m_hizValid = false;
+  for (size_t i = 0; i < numViews; i++) {
+    CullParams params{
+      .prevViewProj = m_hizViewProj,
+      .planes = frusta[i].planes,
+      .numChunks = numChunks,
+      .occlusion = i == 0 && useHiz,
+      .hizSize = m_hizSize,
+    };
+    util::WriteBuffer(m_ctx->queue, m_paramsBuffers[i], 0, &params, sizeof(params));
+  }
+
+  commandEncoder.ClearBuffer(m_countsBuffer);
+  ComputePassEncoder passEncoder =
+    commandEncoder.BeginComputePass(ToPtr(ComputePassDescriptor{
+      .timestampWrites = timestampWrites,
+    }));
+  passEncoder.SetPipeline(m_ctx->pipeline.cullCPL);
+  uint32_t numWorkgroups = (numChunks + 63) / 64;
+  for (size_t i = 0; i < numViews && numWorkgroups > 0; i++) {
+    passEncoder.SetBindGroup(0, m_cullBindGroups[i]);
+    passEncoder.DispatchWorkgroups(numWorkgroups);
+  }
+  passEncoder.End();
+
+  if (!m_readbackBusy) {
+    commandEncoder.CopyBufferToBuffer(
+      m_countsBuffer, 0, m_readbackBuffer, 0, m_countsBuffer.GetSize()
+    );
+    m_readbackBusy = true;
+    m_readbackPending = true;
+  }
+}
+
+void GpuCuller::BuildHiZ(
+  const CommandEncoder &commandEncoder,
+  const ComputePassTimestampWrites *timestampWrites
+) {
+  auto groups = [](glm::uvec2 size) { return (size + glm::uvec2(7)) / glm::uvec2(8); };
+
+  ComputePassEncoder passEncoder =
+    commandEncoder.BeginComputePass(ToPtr(ComputePassDescriptor{
+      .timestampWrites = timestampWrites,
+    }));
+  passEncoder.SetPipeline(m_ctx->pipeline.hizInitCPL);
+  passEncoder.SetBindGroup(0, m_hizInitBindGroup);
+  auto initGroups = groups(m_hizMipSizes[0]);
+  passEncoder.DispatchWorkgroups(initGroups.x, initGroups.y);
+
+  passEncoder.SetPipeline(m_ctx->pipeline.hizDownsampleCPL);
+  for (size_t level = 1; level < m_hizMipSizes.size(); level++) {
+    passEncoder.SetBindGroup(0, m_hizDownsampleBindGroups[level - 1]);
+    auto levelGroups = groups(m_hizMipSizes[level]);
+    passEncoder.DispatchWorkgroups(levelGroups.x, levelGroups.y);
+  }
+  passEncoder.End();
+
+  m_hizViewProj = m_state->player.camera.GetViewProj();
+  m_hizValid = true;
+}
+
+void GpuCuller::ReadBack() {
+  if (!m_readbackPending) return;
+  m_readbackPending = false;
+
+  auto onMapped = [](WGPUBufferMapAsyncStatus status, void *userdata) {
+    auto &culler = *static_cast<GpuCuller *>(userdata);
+    if (status == WGPUBufferMapAsyncStatus_Success) {
+      auto data =
+        static_cast<const uint8_t *>(culler.m_readbackBuffer.GetConstMappedRange());
+      for (size_t i = 0; i < numViews; i++) {
+        std::memcpy(&culler.drawCounts[i], data + i * countsStride, sizeof(DrawCounts));
+      }
+      culler.m_readbackBuffer.Unmap();
+    }
+    culler.m_readbackBusy = false;
+  };
+  m_readbackBuffer.MapAsync(
+    MapMode::Read, 0, m_readbackBuffer.GetSize(), onMapped, this
+  );
+}
+
+} // namespace gfx
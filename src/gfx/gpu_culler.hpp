@@ -0,0 +1,110 @@
+#pragma once
+
+#include "glm/ext/matrix_float4x4.hpp"
+#include "glm/ext/vector_uint2.hpp"
+#include "gfx/context.hpp"
+#include "gfx/sun.hpp"
+#include "util/frustum.hpp"
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <vector>
+
+// forward declaration
+struct GameState;
+
+namespace gfx {
+
+// layout read by DrawIndexedIndirect
+struct DrawIndexedIndirectArgs {
+  uint32_t indexCount;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t firstInstance;
+};
+
+// culls every chunk slot on the gpu and writes indirect draw args per slot, for the
+// camera (frustum and hi-z occlusion against the previous frame's depth) and each
+// shadow cascade (frustum only). culled chunks get an indexCount of 0
+class GpuCuller {
+public:
+  // camera, then each cascade
+  static constexpr size_t numViews = 1 + Sun::maxCascades;
+
+  struct DrawCounts {
+    uint32_t opaque;
+    uint32_t water;
+  };
+
+private:
+  struct CullParams {
+    glm::mat4 prevViewProj;
+    std::array<glm::vec4, 6> planes;
+    uint32_t numChunks;
+    uint32_t occlusion;
+    glm::vec2 hizSize;
+  };
+  // draw counts of each view are bound at this stride (storage offset alignment)
+  static constexpr uint64_t countsStride = 256;
+
+  gfx::Context *m_ctx;
+  GameState *m_state;
+
+  std::array<wgpu::Buffer, numViews> m_paramsBuffers;
+  std::array<wgpu::BindGroup, numViews> m_cullBindGroups;
+
+  // counts are copied out when the previous readback is done, never waited on
+  wgpu::Buffer m_countsBuffer;
+  wgpu::Buffer m_readbackBuffer;
+  bool m_readbackBusy = false;
+  bool m_readbackPending = false;
+
+  // hi-z mip chain of the depth buffer, farthest depth per texel
+  glm::uvec2 m_hizSize;
+  wgpu::BindGroup m_hizInitBindGroup;
+  std::vector<wgpu::BindGroup> m_hizDownsampleBindGroups;
+  std::vector<glm::uvec2> m_hizMipSizes;
+  glm::mat4 m_hizViewProj;
+  bool m_hizValid = false; // built last frame
+
+public:
+  bool enabled = false;
+  bool occlusion = true;
+
+  std::array<wgpu::Buffer, numViews> opaqueArgs;
+  std::array<wgpu::Buffer, numViews> waterArgs;
+  // latest readback, a frame or two behind
+  std::array<DrawCounts, numViews> drawCounts{};
+
+  GpuCuller() = default;
+  GpuCuller(
+    gfx::Context *ctx, GameState *state, wgpu::TextureView depthView,
+    glm::uvec2 depthSize
+  );
+
+  // writes this frame's draw args, before any chunk pass
+  void Cull(
+    const wgpu::CommandEncoder &commandEncoder,
+    const wgpu::ComputePassTimestampWrites *timestampWrites = nullptr
+  );
+  // same against the given camera and cascade frusta, see check_gpu_cull
+  void Cull(
+    const wgpu::CommandEncoder &commandEncoder,
+    const std::array<util::Frustum, numViews> &frusta,
+    const wgpu::ComputePassTimestampWrites *timestampWrites = nullptr
+  );
+  // builds the hi-z for next frame's Cull, after the opaque depth is written
+  void BuildHiZ(
+    const wgpu::CommandEncoder &commandEncoder,
+    const wgpu::ComputePassTimestampWrites *timestampWrites = nullptr
+  );
+  // maps the counts copied by Cull, after the commands are submitted
+  void ReadBack();
+  // drawCounts is about to be written, the device has to be ticked to finish
+  bool ReadingBack() const {
+    return m_readbackBusy;
+  }
+};
+
+} // namespace gfx
@@ -0,0 +1,174 @@
+#include "gpu_timer.hpp"
+#include "util/webgpu-util.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+namespace gfx {
+
+using namespace wgpu;
+
+GpuTimer::GpuTimer(gfx::Context *ctx) : m_ctx(ctx) {
+  if (!m_ctx->timestampQueries) return;
+
+  m_querySet = m_ctx->device.CreateQuerySet(ToPtr(QuerySetDescriptor{
+    .type = QueryType::Timestamp,
+    .count = maxPasses * 2,
+  }));
+  size_t size = maxPasses * 2 * sizeof(uint64_t);
+  m_resolveBuffer = util::CreateBuffer(
+    m_ctx->device, BufferUsage::QueryResolve | BufferUsage::CopySrc, size
+  );
+  m_readbackBuffer = util::CreateBuffer(
+    m_ctx->device, BufferUsage::MapRead | BufferUsage::CopyDst, size
+  );
+}
+
+void GpuTimer::BeginFrame() {
+  m_names.clear();
+  m_frame++;
+}
+
+int GpuTimer::AddPass(const std::string &name) {
+  if (!Available() || m_names.size() == maxPasses) return -1;
+  m_names.push_back(name);
+  return (m_names.size() - 1) * 2;
+}
+
+const RenderPassTimestampWrites *GpuTimer::RenderPass(const std::string &name) {
+  int query = AddPass(name);
+  if (query < 0) return nullptr;
+  auto &writes = m_renderWrites[query / 2];
+  writes = {
+    .querySet = m_querySet,
+    .beginningOfPassWriteIndex = uint32_t(query),
+    .endOfPassWriteIndex = uint32_t(query + 1),
+  };
+  return &writes;
+}
+
+const ComputePassTimestampWrites *GpuTimer::ComputePass(const std::string &name) {
+  int query = AddPass(name);
+  if (query < 0) return nullptr;
+  auto &writes = m_computeWrites[query / 2];
+  writes = {
+    .querySet = m_querySet,
+    .beginningOfPassWriteIndex = uint32_t(query),
+    .endOfPassWriteIndex = uint32_t(query + 1),
+  };
+  return &writes;
+}
+
+void GpuTimer::Resolve(const CommandEncoder &commandEncoder) {
+  if (m_names.empty()) return;
+  uint32_t count = m_names.size() * 2;
+  commandEncoder.ResolveQuerySet(m_querySet, 0, count, m_resolveBuffer, 0);
+
+  if (!m_readbackBusy) {
+    commandEncoder.CopyBufferToBuffer(
+      m_resolveBuffer, 0, m_readbackBuffer, 0, count * sizeof(uint64_t)
+    );
+    m_readbackNames = m_names;
+    m_readbackFrame = m_frame;
+    m_readbackBusy = true;
+    m_readbackPending = true;
+  }
+}
+
+void GpuTimer::ReadBack() {
+  if (!m_readbackPending) return;
+  m_readbackPending = false;
+
+  auto onMapped = [](WGPUBufferMapAsyncStatus status, void *userdata) {
+    auto &timer = *static_cast<GpuTimer *>(userdata);
+    if (status == WGPUBufferMapAsyncStatus_Success) {
+      size_t count = timer.m_readbackNames.size() * 2;
+      std::vector<uint64_t> timestamps(count);
+      std::memcpy(
+        timestamps.data(), timer.m_readbackBuffer.GetConstMappedRange(),
+        count * sizeof(uint64_t)
+      );
+      timer.m_readbackBuffer.Unmap();
+
+      std::map<std::string, double> frame;
+      for (size_t i = 0; i < timer.m_readbackNames.size(); i++) {
+        uint64_t begin = timestamps[i * 2], end = timestamps[i * 2 + 1];
+        // timestamps are in nanoseconds, and may go backwards on some drivers
+        frame[timer.m_readbackNames[i]] += end > begin ? (end - begin) / 1e6 : 0.0;
+      }
+      double total = 0;
+      for (auto &[name, ms] : frame) {
+        auto [it, inserted] = timer.averages.try_emplace(name, ms);
+        if (!inserted) it->second += (ms - it->second) * smoothing;
+        total += ms;
+      }
+      timer.frameAverage += (total - timer.frameAverage) * smoothing;
+
+      timer.m_history.push_back({timer.m_readbackFrame, std::move(frame)});
+      if (timer.m_history.size() > historySize) timer.m_history.pop_front();
+    }
+    timer.m_readbackBusy = false;
+  };
+  m_readbackBuffer.MapAsync(
+    MapMode::Read, 0, m_readbackBuffer.GetSize(), onMapped, this
+  );
+}
+
+void GpuTimer::ExportCsv(const std::string &path) const {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Cannot write " << path << std::endl;
+    return;
+  }
+  std::set<std::string> names;
+  for (auto &frame : m_history) {
+    for (auto &[name, ms] : frame.passes) names.insert(name);
+  }
+
+  file << "frame";
+  for (auto &name : names) file << "," << name;
+  file << "\n";
+  // a pass missing from a frame leaves its cell empty
+  for (auto &frame : m_history) {
+    file << frame.index;
+    for (auto &name : names) {
+      file << ",";
+      auto it = frame.passes.find(name);
+      if (it != frame.passes.end()) file << it->second;
+    }
+    file << "\n";
+  }
+}
+
+void GpuTimer::ExportJson(const std::string &path) const {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Cannot write " << path << std::endl;
+    return;
+  }
+  // pass names are plain literals, nothing to escape
+  auto writePasses = [&](const std::map<std::string, double> &passes) {
+    file << "{";
+    const char *separator = "";
+    for (auto &[name, ms] : passes) {
+      file << separator << "\"" << name << "\": " << ms;
+      separator = ", ";
+    }
+    file << "}";
+  };
+
+  file << "{\n  \"averages\": ";
+  writePasses(averages);
+  file << ",\n  \"frames\": [";
+  const char *separator = "\n";
+  for (auto &frame : m_history) {
+    file << separator << "    {\"frame\": " << frame.index << ", \"passes\": ";
+    writePasses(frame.passes);
+    file << "}";
+    separator = ",\n";
+  }
+  file << "\n  ]\n}\n";
+}
+
+} // namespace gfx
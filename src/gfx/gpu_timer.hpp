@@ -0,0 +1,81 @@
+#pragma once
+
+#include "gfx/context.hpp"
+#include <webgpu/webgpu_cpp.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+// gpu time of render and compute passes from timestamp queries. results are copied
+// out when the previous readback is done and never waited on, so they lag a frame or
+// two. without the TimestampQuery feature no pass is timed and averages stay empty.
+// the last frames read back can be exported for offline comparison
+class GpuTimer {
+public:
+  static constexpr size_t maxPasses = 32; // per frame
+  // weight of the newest frame in the averages
+  static constexpr double smoothing = 0.05;
+  // read back frames kept for Export
+  static constexpr size_t historySize = 600;
+
+private:
+  gfx::Context *m_ctx;
+  wgpu::QuerySet m_querySet; // a begin and end timestamp per pass
+  wgpu::Buffer m_resolveBuffer;
+
+  wgpu::Buffer m_readbackBuffer;
+  bool m_readbackBusy = false;
+  bool m_readbackPending = false;
+
+  // names of this frame's passes, in query order
+  std::vector<std::string> m_names;
+  // names of the passes in the readback buffer
+  std::vector<std::string> m_readbackNames;
+  uint64_t m_frame = 0;
+  uint64_t m_readbackFrame = 0;
+  std::array<wgpu::RenderPassTimestampWrites, maxPasses> m_renderWrites;
+  std::array<wgpu::ComputePassTimestampWrites, maxPasses> m_computeWrites;
+
+  // index of the pass's begin query, or -1 if it isn't timed
+  int AddPass(const std::string &name);
+
+  // per name (ms), frames whose readback was skipped are missing
+  struct Frame {
+    uint64_t index;
+    std::map<std::string, double> passes;
+  };
+  std::deque<Frame> m_history;
+
+public:
+  // per name (ms), passes sharing a name within a frame add up. names that weren't
+  // timed lately keep their last average
+  std::map<std::string, double> averages;
+  double frameAverage = 0; // every pass of a frame (ms)
+
+  GpuTimer() = default;
+  GpuTimer(gfx::Context *ctx);
+  bool Available() {
+    return m_querySet != nullptr;
+  }
+
+  // before encoding the frame's first timed pass
+  void BeginFrame();
+  // set as the pass descriptor's timestampWrites, null if the pass isn't timed
+  const wgpu::RenderPassTimestampWrites *RenderPass(const std::string &name);
+  const wgpu::ComputePassTimestampWrites *ComputePass(const std::string &name);
+  // after the frame's last timed pass
+  void Resolve(const wgpu::CommandEncoder &commandEncoder);
+  // maps the timestamps copied by Resolve, after the commands are submitted
+  void ReadBack();
+  // the kept frames, as csv with a column per name or as json
+  void ExportCsv(const std::string &path) const;
+  void ExportJson(const std::string &path) const;
+};
+
+} // namespace gfx
@@ -1,6 +1,7 @@
 #include "pipeline.hpp"
 #include "dawn/utils/WGPUHelpers.h"
 #include "game/chunk.hpp"
+#include "game/far_terrain.hpp"
 #include "gfx/context.hpp"
 #include "util/webgpu-util.hpp"
 #include <vector>
@@ -10,6 +11,17 @@ namespace gfx {
 using namespace wgpu;
 using VertexAttribs = game::Chunk::VertexAttribs;
 
+static VertexBufferLayout ChunkDepthVBL() {
+  static std::vector<VertexAttribute> vertexAttributes{
+    {VertexFormat::Uint32, 0, 0},
+  };
+  return {
+    .arrayStride = sizeof(uint32_t),
+    .attributeCount = vertexAttributes.size(),
+    .attributes = vertexAttributes.data(),
+  };
+}
+
 Pipeline::Pipeline(gfx::Context &ctx) {
   // chunk vbo layout
   VertexBufferLayout chunkVBL;
@@ -25,13 +37,35 @@ Pipeline::Pipeline(gfx::Context &ctx) {
     };
   }
 
+  // chunk depth mesh vbo layout, positions only
+  VertexBufferLayout chunkDepthVBL = ChunkDepthVBL();
+
+  // far terrain vbo layout
+  VertexBufferLayout farTerrainVBL;
+  {
+    using FarVertex = game::FarTerrain::Vertex;
+    static std::vector<VertexAttribute> vertexAttributes{
+      {VertexFormat::Float32x3, offsetof(FarVertex, position), 0},
+      {VertexFormat::Float32x3, offsetof(FarVertex, normal), 1},
+      {VertexFormat::Float32x3, offsetof(FarVertex, color), 2},
+    };
+    farTerrainVBL = {
+      .arrayStride = sizeof(FarVertex),
+      .attributeCount = vertexAttributes.size(),
+      .attributes = vertexAttributes.data(),
+    };
+  }
+
   // cameraLayout
+  auto cameraStages =
+    ShaderStage::Vertex | ShaderStage::Fragment | ShaderStage::Compute;
   cameraBGL = dawn::utils::MakeBindGroupLayout(
     ctx.device,
     {
-      {0, ShaderStage::Vertex | ShaderStage::Fragment, BufferBindingType::Uniform},
-      {1, ShaderStage::Vertex | ShaderStage::Fragment, BufferBindingType::Uniform},
-      {2, ShaderStage::Vertex | ShaderStage::Fragment, BufferBindingType::Uniform},
+      {0, cameraStages, BufferBindingType::Uniform},
+      {1, cameraStages, BufferBindingType::Uniform},
+      {2, cameraStages, BufferBindingType::Uniform},
+      {3, cameraStages, BufferBindingType::Uniform}, // previous frame's view
     }
   );
   // texture layout
@@ -42,11 +76,11 @@ Pipeline::Pipeline(gfx::Context &ctx) {
       {1, ShaderStage::Fragment, SamplerBindingType::Filtering},
     }
   );
-  // chunk layout (world pos)
+  // chunk layout (world pos), one shared buffer indexed by dynamic offset
   chunkBGL = dawn::utils::MakeBindGroupLayout(
     ctx.device,
     {
-      {0, ShaderStage::Vertex, BufferBindingType::Uniform},
+      {0, ShaderStage::Vertex, BufferBindingType::Uniform, true},
     }
   );
   // lighting layout (sunDir, sunViewProj)
@@ -60,46 +94,46 @@ Pipeline::Pipeline(gfx::Context &ctx) {
   );
 
   // shadow pipeline --------------------------------------------------
-  ShaderModule shaderShadow =
-    util::LoadShaderModule(ROOT_DIR "/res/shaders/shadow.wgsl", ctx.device);
-
   shadowBGL = dawn::utils::MakeBindGroupLayout(
     ctx.device, {{0, ShaderStage::Vertex, BufferBindingType::Uniform}}
   );
 
-  shadowRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
-    .layout = dawn::utils::MakePipelineLayout(
-      ctx.device,
-      {
-        shadowBGL,
-        sunBGL,
-        textureBGL,
-        chunkBGL,
-      }
-    ),
-    .vertex =
-      VertexState{
-        .module = shaderShadow,
-        .entryPoint = "vs_main",
-        .bufferCount = 1,
-        .buffers = &chunkVBL,
-      },
-    .primitive =
-      PrimitiveState{
-        .cullMode = CullMode::Back,
-      },
-    .depthStencil = ToPtr(DepthStencilState{
-      .format = TextureFormat::Depth32Float,
-      .depthWriteEnabled = true,
-      .depthCompare = CompareFunction::Less,
-    }),
-    .fragment = ToPtr(FragmentState{
-      .module = shaderShadow,
-      .entryPoint = "fs_main",
-    }),
-  }));
+  // shared so the bind groups stay set when switching between the shadow pipelines
+  shadowPL = dawn::utils::MakePipelineLayout(
+    ctx.device,
+    {
+      shadowBGL,
+      sunBGL,
+      textureBGL,
+      chunkBGL,
+    }
+  );
+  CreateShadowPipelines(ctx.device, TextureFormat::Depth32Float);
 
   // g_buffer pipeline -------------------------------------------------
+  // gbuffer writers come in both layouts, see Renderer::compactGBuffer
+  // full: position (view-space), normal, albedo
+  // compact: octahedral normal and surface flag, albedo
+  std::vector<ColorTargetState> fullTargets = {
+    {.format = TextureFormat::RGBA16Float},
+    {.format = TextureFormat::RGBA16Float},
+    {.format = TextureFormat::BGRA8Unorm, .blend = &util::BlendState::AlphaBlending},
+  };
+  std::vector<ColorTargetState> compactTargets = {
+    {.format = TextureFormat::RGBA8Unorm},
+    {.format = TextureFormat::BGRA8Unorm, .blend = &util::BlendState::AlphaBlending},
+  };
+  // far terrain is opaque
+  std::vector<ColorTargetState> opaqueFullTargets = {
+    {.format = TextureFormat::RGBA16Float},
+    {.format = TextureFormat::RGBA16Float},
+    {.format = TextureFormat::BGRA8Unorm},
+  };
+  std::vector<ColorTargetState> opaqueCompactTargets = {
+    {.format = TextureFormat::RGBA8Unorm},
+    {.format = TextureFormat::BGRA8Unorm},
+  };
+
   ShaderModule shaderGBuffer =
     util::LoadShaderModule(ROOT_DIR "/res/shaders/g_buffer.wgsl", ctx.device);
 
@@ -109,86 +143,80 @@ Pipeline::Pipeline(gfx::Context &ctx) {
   ShaderModule shaderGBufferDepth =
     util::LoadShaderModule(ROOT_DIR "/res/shaders/g_buffer_depth.wgsl", ctx.device);
 
-  gBufferRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
-    .layout = dawn::utils::MakePipelineLayout(
-      ctx.device,
-      {
-        cameraBGL,
-        textureBGL,
-        chunkBGL,
-      }
-    ),
-    .vertex =
-      VertexState{
-        .module = shaderGBuffer,
-        .entryPoint = "vs_main",
-        .bufferCount = 1,
-        .buffers = &chunkVBL,
-      },
-    .primitive =
-      PrimitiveState{
-        .cullMode = CullMode::Back,
-      },
-    .depthStencil = ToPtr(DepthStencilState{
-      .format = ctx.depthFormat,
-      .depthWriteEnabled = true,
-      .depthCompare = CompareFunction::Less,
-    }),
-    .fragment = ToPtr(FragmentState{
-      .module = shaderGBuffer,
-      .entryPoint = "fs_main",
-      .targetCount = 3,
-      .targets = ToPtr<ColorTargetState>({
-        {.format = TextureFormat::RGBA16Float}, // position
-        {.format = TextureFormat::RGBA16Float}, // normal
+  for (bool compact : {false, true}) {
+    auto &targets = compact ? compactTargets : fullTargets;
+    auto &rpl = compact ? gBufferCompactRPL : gBufferRPL;
+    rpl = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+      .layout = dawn::utils::MakePipelineLayout(
+        ctx.device,
         {
-          .format = TextureFormat::BGRA8Unorm,
-          .blend = &util::BlendState::AlphaBlending,
-        }, // albedo
+          cameraBGL,
+          textureBGL,
+          chunkBGL,
+        }
+      ),
+      .vertex =
+        VertexState{
+          .module = shaderGBuffer,
+          .entryPoint = "vs_main",
+          .bufferCount = 1,
+          .buffers = &chunkVBL,
+        },
+      .primitive =
+        PrimitiveState{
+          .cullMode = CullMode::Back,
+        },
+      .depthStencil = ToPtr(DepthStencilState{
+        .format = ctx.depthFormat,
+        .depthWriteEnabled = true,
+        .depthCompare = CompareFunction::Less,
       }),
-    }),
-  }));
+      .fragment = ToPtr(FragmentState{
+        .module = shaderGBuffer,
+        .entryPoint = compact ? "fs_compact" : "fs_main",
+        .targetCount = targets.size(),
+        .targets = targets.data(),
+      }),
+    }));
+  }
 
-  gBufferWireRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
-    .layout = dawn::utils::MakePipelineLayout(
-      ctx.device,
-      {
-        cameraBGL,
-        textureBGL,
-        chunkBGL,
-      }
-    ),
-    .vertex =
-      VertexState{
-        .module = shaderGBufferWire,
-        .entryPoint = "vs_main",
-        .bufferCount = 1,
-        .buffers = &chunkVBL,
-      },
-    .primitive =
-      PrimitiveState{
-        .topology = PrimitiveTopology::LineList,
-        .cullMode = CullMode::Back,
-      },
-    .depthStencil = ToPtr(DepthStencilState{
-      .format = ctx.depthFormat,
-      .depthWriteEnabled = true,
-      .depthCompare = CompareFunction::LessEqual,
-    }),
-    .fragment = ToPtr(FragmentState{
-      .module = shaderGBufferWire,
-      .entryPoint = "fs_main",
-      .targetCount = 3,
-      .targets = ToPtr<ColorTargetState>({
-        {.format = TextureFormat::RGBA16Float}, // position
-        {.format = TextureFormat::RGBA16Float}, // normal
+  for (bool compact : {false, true}) {
+    auto &targets = compact ? compactTargets : fullTargets;
+    auto &rpl = compact ? gBufferWireCompactRPL : gBufferWireRPL;
+    rpl = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+      .layout = dawn::utils::MakePipelineLayout(
+        ctx.device,
         {
-          .format = TextureFormat::BGRA8Unorm,
-          .blend = &util::BlendState::AlphaBlending,
-        }, // albedo
+          cameraBGL,
+          textureBGL,
+          chunkBGL,
+        }
+      ),
+      .vertex =
+        VertexState{
+          .module = shaderGBufferWire,
+          .entryPoint = "vs_main",
+          .bufferCount = 1,
+          .buffers = &chunkVBL,
+        },
+      .primitive =
+        PrimitiveState{
+          .topology = PrimitiveTopology::LineList,
+          .cullMode = CullMode::Back,
+        },
+      .depthStencil = ToPtr(DepthStencilState{
+        .format = ctx.depthFormat,
+        .depthWriteEnabled = true,
+        .depthCompare = CompareFunction::LessEqual,
       }),
-    }),
-  }));
+      .fragment = ToPtr(FragmentState{
+        .module = shaderGBufferWire,
+        .entryPoint = compact ? "fs_compact" : "fs_main",
+        .targetCount = targets.size(),
+        .targets = targets.data(),
+      }),
+    }));
+  }
 
   gBufferDepthRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
     .layout = dawn::utils::MakePipelineLayout(
@@ -204,7 +232,7 @@ Pipeline::Pipeline(gfx::Context &ctx) {
         .module = shaderGBufferDepth,
         .entryPoint = "vs_main",
         .bufferCount = 1,
-        .buffers = &chunkVBL,
+        .buffers = &chunkDepthVBL,
       },
     .primitive =
       PrimitiveState{
@@ -218,6 +246,40 @@ Pipeline::Pipeline(gfx::Context &ctx) {
     }),
   }));
 
+  // far terrain pipeline --------------------------------------------
+  ShaderModule shaderFarTerrain =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/far_terrain.wgsl", ctx.device);
+
+  for (bool compact : {false, true}) {
+    auto &targets = compact ? opaqueCompactTargets : opaqueFullTargets;
+    auto &rpl = compact ? farTerrainCompactRPL : farTerrainRPL;
+    rpl = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+      .layout = dawn::utils::MakePipelineLayout(ctx.device, {cameraBGL}),
+      .vertex =
+        VertexState{
+          .module = shaderFarTerrain,
+          .entryPoint = "vs_main",
+          .bufferCount = 1,
+          .buffers = &farTerrainVBL,
+        },
+      .primitive =
+        PrimitiveState{
+          .cullMode = CullMode::None,
+        },
+      .depthStencil = ToPtr(DepthStencilState{
+        .format = ctx.depthFormat,
+        .depthWriteEnabled = true,
+        .depthCompare = CompareFunction::Less,
+      }),
+      .fragment = ToPtr(FragmentState{
+        .module = shaderFarTerrain,
+        .entryPoint = compact ? "fs_compact" : "fs_main",
+        .targetCount = targets.size(),
+        .targets = targets.data(),
+      }),
+    }));
+  }
+
   // water pipeline --------------------------------------------------
   ShaderModule shaderWater =
     util::LoadShaderModule(ROOT_DIR "/res/shaders/water.wgsl", ctx.device);
@@ -311,23 +373,26 @@ Pipeline::Pipeline(gfx::Context &ctx) {
     .attributes = vertexAttributes.data(),
   };
 
+  // also read by the compute ssao path
+  auto ssaoStages = ShaderStage::Fragment | ShaderStage::Compute;
   gBufferBGL = dawn::utils::MakeBindGroupLayout(
     ctx.device,
     {
-      {0, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
-      {1, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
-      {2, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
-      {3, ShaderStage::Fragment, SamplerBindingType::NonFiltering},
+      {0, ssaoStages, TextureSampleType::UnfilterableFloat},
+      {1, ssaoStages, TextureSampleType::UnfilterableFloat},
+      {2, ssaoStages, TextureSampleType::UnfilterableFloat},
+      {3, ssaoStages, SamplerBindingType::NonFiltering},
+      {4, ssaoStages, BufferBindingType::Uniform}, // GBufferParams
     }
   );
 
   ssaoSamplingBGL = dawn::utils::MakeBindGroupLayout(
     ctx.device,
     {
-      {0, ShaderStage::Fragment, BufferBindingType::Uniform},
-      {1, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
-      {2, ShaderStage::Fragment, SamplerBindingType::NonFiltering},
-      {3, ShaderStage::Fragment, BufferBindingType::Uniform},
+      {0, ssaoStages, BufferBindingType::Uniform},
+      {1, ssaoStages, TextureSampleType::UnfilterableFloat},
+      {2, ssaoStages, SamplerBindingType::NonFiltering},
+      {3, ssaoStages, BufferBindingType::Uniform},
     }
   );
 
@@ -389,6 +454,163 @@ Pipeline::Pipeline(gfx::Context &ctx) {
     }),
   }));
 
+  // half resolution ssao pipelines ----------------------------------------
+  // ssaoRPL and blurRPL run in between, on the downsampled gbuffer
+  ShaderModule shaderFragSsaoDownsample = util::LoadShaderModule(
+    ROOT_DIR "/res/shaders/frag_ssao_downsample.wgsl", ctx.device
+  );
+  ShaderModule shaderFragSsaoUpsample = util::LoadShaderModule(
+    ROOT_DIR "/res/shaders/frag_ssao_upsample.wgsl", ctx.device
+  );
+
+  ssaoDownsampleRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(ctx.device, {gBufferBGL}),
+    .vertex =
+      VertexState{
+        .module = shaderVertQuad,
+        .entryPoint = "vs_main",
+        .bufferCount = 1,
+        .buffers = &quadVertexBufferLayout,
+      },
+    .fragment = ToPtr(FragmentState{
+      .module = shaderFragSsaoDownsample,
+      .entryPoint = "fs_main",
+      .targetCount = 2,
+      .targets = ToPtr<ColorTargetState>({
+        {.format = TextureFormat::RGBA16Float},
+        {.format = TextureFormat::RGBA16Float},
+      }),
+    }),
+  }));
+
+  ssaoUpsampleBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
+      {1, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
+      {2, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
+    }
+  );
+
+  ssaoUpsampleRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout =
+      dawn::utils::MakePipelineLayout(ctx.device, {gBufferBGL, ssaoUpsampleBGL}),
+    .vertex =
+      VertexState{
+        .module = shaderVertQuad,
+        .entryPoint = "vs_main",
+        .bufferCount = 1,
+        .buffers = &quadVertexBufferLayout,
+      },
+    .fragment = ToPtr(FragmentState{
+      .module = shaderFragSsaoUpsample,
+      .entryPoint = "fs_main",
+      .targetCount = 1,
+      .targets = ToPtr<ColorTargetState>({
+        {.format = TextureFormat::R8Unorm},
+      }),
+    }),
+  }));
+
+  // temporal ssao pipeline ------------------------------------------------
+  ShaderModule shaderFragSsaoTemporal = util::LoadShaderModule(
+    ROOT_DIR "/res/shaders/frag_ssao_temporal.wgsl", ctx.device
+  );
+
+  ssaoTemporalBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
+      {1, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
+    }
+  );
+
+  ssaoTemporalRPL = ctx.device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(
+      ctx.device,
+      {
+        cameraBGL,
+        gBufferBGL,
+        ssaoTemporalBGL,
+      }
+    ),
+    .vertex =
+      VertexState{
+        .module = shaderVertQuad,
+        .entryPoint = "vs_main",
+        .bufferCount = 1,
+        .buffers = &quadVertexBufferLayout,
+      },
+    .fragment = ToPtr(FragmentState{
+      .module = shaderFragSsaoTemporal,
+      .entryPoint = "fs_main",
+      .targetCount = 1,
+      .targets = ToPtr<ColorTargetState>({
+        {.format = TextureFormat::RGBA16Float},
+      }),
+    }),
+  }));
+
+  // compute ssao pipelines -----------------------------------------------
+  ShaderModule shaderCompSsao =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/comp_ssao.wgsl", ctx.device);
+  ShaderModule shaderCompBlur =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/comp_blur.wgsl", ctx.device);
+
+  ssaoOutputBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Compute, StorageTextureAccess::WriteOnly,
+       TextureFormat::R32Float},
+    }
+  );
+
+  ssaoBlurBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Compute, TextureSampleType::UnfilterableFloat},
+      {1, ShaderStage::Compute, StorageTextureAccess::WriteOnly,
+       TextureFormat::R32Float},
+    }
+  );
+
+  ssaoCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(
+      ctx.device,
+      {
+        cameraBGL,
+        gBufferBGL,
+        ssaoSamplingBGL,
+        ssaoOutputBGL,
+      }
+    ),
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompSsao,
+        .entryPoint = "cs_main",
+      },
+  }));
+
+  PipelineLayout blurPL =
+    dawn::utils::MakePipelineLayout(ctx.device, {gBufferBGL, ssaoBlurBGL});
+  blurHorizontalCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = blurPL,
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompBlur,
+        .entryPoint = "cs_horizontal",
+      },
+  }));
+
+  blurVerticalCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = blurPL,
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompBlur,
+        .entryPoint = "cs_vertical",
+      },
+  }));
+
   // composite pipeline --------------------------------------------------
   ShaderModule shaderFragComposite =
     util::LoadShaderModule(ROOT_DIR "/res/shaders/frag_composite.wgsl", ctx.device);
@@ -398,9 +620,9 @@ Pipeline::Pipeline(gfx::Context &ctx) {
     {
       {0, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
       {1, ShaderStage::Fragment, TextureSampleType::UnfilterableFloat},
-      {2, ShaderStage::Fragment, TextureSampleType::Depth,
-       TextureViewDimension::e2DArray},
+      {2, ShaderStage::Fragment, TextureSampleType::Depth},
       {3, ShaderStage::Fragment, SamplerBindingType::Comparison},
+      {4, ShaderStage::Fragment, BufferBindingType::Uniform},
     }
   );
 
@@ -431,6 +653,132 @@ Pipeline::Pipeline(gfx::Context &ctx) {
       }),
     }),
   }));
+
+  // gpu culling pipelines -------------------------------------------
+  ShaderModule shaderCompCull =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/comp_cull.wgsl", ctx.device);
+  ShaderModule shaderCompHiz =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/comp_hiz.wgsl", ctx.device);
+
+  cullBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Compute, BufferBindingType::Uniform},
+      {1, ShaderStage::Compute, BufferBindingType::ReadOnlyStorage},
+      {2, ShaderStage::Compute, BufferBindingType::Storage},
+      {3, ShaderStage::Compute, BufferBindingType::Storage},
+      {4, ShaderStage::Compute, BufferBindingType::Storage},
+      {5, ShaderStage::Compute, TextureSampleType::UnfilterableFloat},
+    }
+  );
+
+  hizInitBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {0, ShaderStage::Compute, TextureSampleType::Depth},
+      {2, ShaderStage::Compute, StorageTextureAccess::WriteOnly,
+       TextureFormat::R32Float},
+    }
+  );
+
+  hizDownsampleBGL = dawn::utils::MakeBindGroupLayout(
+    ctx.device,
+    {
+      {1, ShaderStage::Compute, TextureSampleType::UnfilterableFloat},
+      {2, ShaderStage::Compute, StorageTextureAccess::WriteOnly,
+       TextureFormat::R32Float},
+    }
+  );
+
+  cullCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(ctx.device, {cullBGL}),
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompCull,
+        .entryPoint = "cs_main",
+      },
+  }));
+
+  hizInitCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(ctx.device, {hizInitBGL}),
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompHiz,
+        .entryPoint = "cs_init",
+      },
+  }));
+
+  hizDownsampleCPL = ctx.device.CreateComputePipeline(ToPtr(ComputePipelineDescriptor{
+    .layout = dawn::utils::MakePipelineLayout(ctx.device, {hizDownsampleBGL}),
+    .compute =
+      ProgrammableStageDescriptor{
+        .module = shaderCompHiz,
+        .entryPoint = "cs_downsample",
+      },
+  }));
+}
+
+void Pipeline::CreateShadowPipelines(wgpu::Device &device, wgpu::TextureFormat format) {
+  shadowFormat = format;
+  ShaderModule shaderShadow =
+    util::LoadShaderModule(ROOT_DIR "/res/shaders/shadow.wgsl", device);
+  VertexBufferLayout chunkDepthVBL = ChunkDepthVBL();
+  DepthStencilState depthStencil{
+    .format = format,
+    .depthWriteEnabled = true,
+    .depthCompare = CompareFunction::Less,
+  };
+
+  shadowRPL = device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout = shadowPL,
+    .vertex =
+      VertexState{
+        .module = shaderShadow,
+        .entryPoint = "vs_main",
+        .bufferCount = 1,
+        .buffers = &chunkDepthVBL,
+      },
+    .primitive =
+      PrimitiveState{
+        .cullMode = CullMode::Back,
+      },
+    .depthStencil = &depthStencil,
+  }));
+
+  shadowAlphaRPL = device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout = shadowPL,
+    .vertex =
+      VertexState{
+        .module = shaderShadow,
+        .entryPoint = "vs_main",
+        .bufferCount = 1,
+        .buffers = &chunkDepthVBL,
+      },
+    .primitive =
+      PrimitiveState{
+        .cullMode = CullMode::Back,
+      },
+    .depthStencil = &depthStencil,
+    .fragment = ToPtr(FragmentState{
+      .module = shaderShadow,
+      .entryPoint = "fs_main",
+    }),
+  }));
+
+  // resets one cascade's rect of the atlas to the far plane, see vs_clear
+  shadowClearRPL = device.CreateRenderPipeline(ToPtr(RenderPipelineDescriptor{
+    .layout = shadowPL,
+    .vertex =
+      VertexState{
+        .module = shaderShadow,
+        .entryPoint = "vs_clear",
+      },
+    .depthStencil = ToPtr(DepthStencilState{
+      .format = format,
+      .depthWriteEnabled = true,
+      .depthCompare = CompareFunction::Always,
+    }),
+  }));
 }
 
 } // namespace gfx
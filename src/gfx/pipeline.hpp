@@ -19,22 +19,51 @@ struct Pipeline {
   wgpu::BindGroupLayout ssaoSamplingBGL;
 
   wgpu::BindGroupLayout ssaoTextureBGL;
+  wgpu::BindGroupLayout ssaoUpsampleBGL;
+  wgpu::BindGroupLayout ssaoOutputBGL;
+  wgpu::BindGroupLayout ssaoBlurBGL;
+  wgpu::BindGroupLayout ssaoTemporalBGL;
 
   wgpu::BindGroupLayout compositeBGL;
 
+  wgpu::BindGroupLayout cullBGL;
+  wgpu::BindGroupLayout hizInitBGL;
+  wgpu::BindGroupLayout hizDownsampleBGL;
+
   // render pipelines
-  wgpu::RenderPipeline shadowRPL;
+  // shadow pipelines follow the atlas format, see CreateShadowPipelines
+  wgpu::PipelineLayout shadowPL;
+  wgpu::TextureFormat shadowFormat;
+  wgpu::RenderPipeline shadowRPL; // depth only
+  wgpu::RenderPipeline shadowAlphaRPL; // alpha tested faces
+  wgpu::RenderPipeline shadowClearRPL;
   wgpu::RenderPipeline gBufferRPL;
+  wgpu::RenderPipeline gBufferCompactRPL;
   wgpu::RenderPipeline gBufferWireRPL;
+  wgpu::RenderPipeline gBufferWireCompactRPL;
   wgpu::RenderPipeline gBufferDepthRPL;
+  wgpu::RenderPipeline farTerrainRPL;
+  wgpu::RenderPipeline farTerrainCompactRPL;
   wgpu::RenderPipeline waterRPL;
   wgpu::RenderPipeline waterWireRPL;
   wgpu::RenderPipeline ssaoRPL;
   wgpu::RenderPipeline blurRPL;
+  wgpu::RenderPipeline ssaoDownsampleRPL;
+  wgpu::RenderPipeline ssaoUpsampleRPL;
+  wgpu::RenderPipeline ssaoTemporalRPL;
   wgpu::RenderPipeline compositeRPL;
 
+  // compute pipelines
+  wgpu::ComputePipeline cullCPL;
+  wgpu::ComputePipeline hizInitCPL;
+  wgpu::ComputePipeline hizDownsampleCPL;
+  wgpu::ComputePipeline ssaoCPL;
+  wgpu::ComputePipeline blurHorizontalCPL;
+  wgpu::ComputePipeline blurVerticalCPL;
+
   Pipeline() = default;
   Pipeline(gfx::Context &ctx);
+  void CreateShadowPipelines(wgpu::Device &device, wgpu::TextureFormat format);
 };
 
 } // namespace gfx
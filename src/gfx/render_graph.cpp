@@ -0,0 +1,164 @@
+#include "render_graph.hpp"
+#include "dawn/utils/TextureUtils.h"
+#include "util/profiler.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace gfx {
+
+using namespace wgpu;
+
+using TextureDesc = RenderGraph::TextureDesc;
+
+static bool SameDesc(const TextureDesc &a, const TextureDesc &b) {
+  return a.size.width == b.size.width && a.size.height == b.size.height &&
+         a.size.depthOrArrayLayers == b.size.depthOrArrayLayers &&
+         a.format == b.format && a.usage == b.usage;
+}
+
+static size_t TextureBytes(const TextureDesc &desc) {
+  return size_t(desc.size.width) * desc.size.height * desc.size.depthOrArrayLayers *
+         dawn::utils::GetTexelBlockSizeInBytes(desc.format);
+}
+
+RenderGraph::RenderGraph(gfx::Context *ctx) : m_ctx(ctx) {
+}
+
+void RenderGraph::Reset() {
+  m_textures.clear();
+  m_passes.clear();
+  m_zoneNames.clear();
+  m_kept.clear();
+}
+
+RenderGraph::Handle
+RenderGraph::CreateTexture(const std::string &name, const TextureDesc &desc) {
+  m_textures.push_back({.name = name, .desc = desc});
+  return m_textures.size() - 1;
+}
+
+RenderGraph::Handle
+RenderGraph::ImportTexture(const std::string &name, wgpu::Texture texture) {
+  m_textures.push_back({.name = name, .imported = texture});
+  return m_textures.size() - 1;
+}
+
+void RenderGraph::AddPass(Pass pass) {
+  m_zoneNames.push_back(util::Profiler::Intern(pass.name));
+  m_passes.push_back(std::move(pass));
+}
+
+void RenderGraph::Compile() {
+  // backwards, a pass is kept if it's an output or writes something a kept pass
+  // after it reads. a write covers the reads after it, unless the pass reads too
+  std::vector<bool> needed(m_textures.size(), false);
+  m_kept.assign(m_passes.size(), false);
+  culledPasses = 0;
+  for (int i = m_passes.size() - 1; i >= 0; i--) {
+    auto &pass = m_passes[i];
+    bool kept = pass.output;
+    for (Handle handle : pass.writes) kept |= needed[handle];
+    if (!kept) {
+      culledPasses++;
+      continue;
+    }
+    m_kept[i] = true;
+    for (Handle handle : pass.writes) needed[handle] = false;
+    for (Handle handle : pass.reads) needed[handle] = true;
+  }
+
+  for (auto &texture : m_textures) {
+    texture.physical = -1;
+    texture.firstUse = m_passes.size();
+    texture.lastUse = -1;
+  }
+  for (int i = 0; i < (int)m_passes.size(); i++) {
+    if (!m_kept[i]) continue;
+    for (auto *handles : {&m_passes[i].reads, &m_passes[i].writes}) {
+      for (Handle handle : *handles) {
+        m_textures[handle].firstUse = std::min(m_textures[handle].firstUse, i);
+        m_textures[handle].lastUse = std::max(m_textures[handle].lastUse, i);
+      }
+    }
+  }
+
+  // in order of first use, each transient texture takes a pooled texture that is
+  // free by then, or a new one
+  std::vector<Handle> order(m_textures.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+    return m_textures[a].firstUse < m_textures[b].firstUse;
+  });
+  for (auto &physical : m_physical) physical.freeAfter = -1;
+  std::vector<bool> assigned(m_physical.size(), false);
+  transientBytes = 0;
+  for (Handle handle : order) {
+    auto &texture = m_textures[handle];
+    if (texture.imported || texture.lastUse < 0) continue;
+    transientBytes += TextureBytes(texture.desc);
+
+    int match = -1;
+    for (int p = 0; p < (int)m_physical.size(); p++) {
+      if (SameDesc(m_physical[p].desc, texture.desc) &&
+          m_physical[p].freeAfter < texture.firstUse) {
+        match = p;
+        break;
+      }
+    }
+    if (match < 0) {
+      m_physical.push_back({
+        .desc = texture.desc,
+        .texture = m_ctx->device.CreateTexture(ToPtr(TextureDescriptor{
+          .label = texture.name.c_str(),
+          .usage = texture.desc.usage,
+          .size = texture.desc.size,
+          .format = texture.desc.format,
+        })),
+      });
+      assigned.push_back(false);
+      match = m_physical.size() - 1;
+    }
+    m_physical[match].freeAfter = texture.lastUse;
+    assigned[match] = true;
+    texture.physical = match;
+  }
+
+  // textures left over from the last Compile go, along with their memory
+  std::vector<int> remap(m_physical.size(), -1);
+  std::vector<Physical> pool;
+  allocatedBytes = 0;
+  for (size_t p = 0; p < m_physical.size(); p++) {
+    if (!assigned[p]) {
+      m_physical[p].texture.Destroy();
+      continue;
+    }
+    remap[p] = pool.size();
+    allocatedBytes += TextureBytes(m_physical[p].desc);
+    pool.push_back(std::move(m_physical[p]));
+  }
+  m_physical = std::move(pool);
+  for (auto &texture : m_textures) {
+    if (texture.physical >= 0) texture.physical = remap[texture.physical];
+  }
+
+  for (size_t i = 0; i < m_passes.size(); i++) {
+    if (m_kept[i] && m_passes[i].setup) m_passes[i].setup();
+  }
+}
+
+void RenderGraph::Execute(const wgpu::CommandEncoder &commandEncoder) {
+  for (size_t i = 0; i < m_passes.size(); i++) {
+    if (!m_kept[i]) continue;
+    PROFILE_ZONE(m_zoneNames[i]);
+    m_passes[i].execute(commandEncoder);
+  }
+}
+
+wgpu::Texture RenderGraph::GetTexture(Handle handle) const {
+  auto &texture = m_textures[handle];
+  if (texture.imported) return texture.imported;
+  if (texture.physical < 0) return nullptr;
+  return m_physical[texture.physical].texture;
+}
+
+} // namespace gfx
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "gfx/context.hpp"
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gfx {
+
+// the frame's passes in execution order and the textures each reads and writes.
+// Compile drops passes whose writes no later pass reads, then transient textures
+// whose lifetimes don't overlap share a gpu texture. webgpu has no placed resources,
+// so only textures of the same size, format and usage can share
+class RenderGraph {
+public:
+  using Handle = uint32_t;
+
+  struct TextureDesc {
+    wgpu::Extent3D size;
+    wgpu::TextureFormat format;
+    wgpu::TextureUsage usage =
+      wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<Handle> reads; // loaded attachments count as reads too
+    std::vector<Handle> writes;
+    // kept even if nothing reads what it writes, e.g. it presents or feeds the
+    // next frame
+    bool output = false;
+    // once per Compile if the pass is kept, its textures exist by then. creates
+    // what refers to them: pass descriptors, bind groups
+    std::function<void()> setup;
+    std::function<void(const wgpu::CommandEncoder &)> execute;
+  };
+
+private:
+  gfx::Context *m_ctx;
+
+  struct Texture {
+    std::string name;
+    TextureDesc desc;
+    wgpu::Texture imported; // null if transient
+    int physical = -1; // index in m_physical, transient and used only
+    int firstUse, lastUse; // kept pass indices
+  };
+  std::vector<Texture> m_textures;
+  std::vector<Pass> m_passes;
+  std::vector<const char *> m_zoneNames; // profiler zones, one per pass
+  std::vector<bool> m_kept;
+
+  // gpu textures behind the transient ones, reused by the next Compile when the
+  // desc matches and destroyed when nothing needs them anymore
+  struct Physical {
+    TextureDesc desc;
+    wgpu::Texture texture;
+    int freeAfter; // last pass using it, -1 if unassigned
+  };
+  std::vector<Physical> m_physical;
+
+public:
+  // from the last Compile
+  size_t culledPasses = 0;
+  size_t transientBytes = 0; // every used transient texture on its own
+  size_t allocatedBytes = 0; // after sharing
+
+  RenderGraph() = default;
+  RenderGraph(gfx::Context *ctx);
+
+  // drops the passes and textures, gpu textures stay in the pool until Compile
+  void Reset();
+  Handle CreateTexture(const std::string &name, const TextureDesc &desc);
+  // created and kept by the caller, e.g. written in one frame and read in the next
+  Handle ImportTexture(const std::string &name, wgpu::Texture texture);
+  void AddPass(Pass pass);
+  void Compile();
+  // the kept passes, in the order they were added
+  void Execute(const wgpu::CommandEncoder &commandEncoder);
+
+  // null if no kept pass uses it
+  wgpu::Texture GetTexture(Handle handle) const;
+  wgpu::TextureView GetView(Handle handle) const {
+    return GetTexture(handle).CreateView();
+  }
+  const std::vector<Pass> &GetPasses() const {
+    return m_passes;
+  }
+  bool IsKept(size_t passIndex) const {
+    return m_kept[passIndex];
+  }
+};
+
+} // namespace gfx
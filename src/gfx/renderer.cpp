@@ -1,8 +1,12 @@
 #include "renderer.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <iostream>
+#include <numeric>
 #include <ostream>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <dawn/utils/WGPUHelpers.h>
@@ -16,6 +20,8 @@
 #include "game.hpp"
 #include "gfx/context.hpp"
 #include "game/block.hpp"
+#include "util/frame_stats.hpp"
+#include "util/profiler.hpp"
 #include "util/webgpu-util.hpp"
 
 namespace gfx {
@@ -38,33 +44,36 @@ Renderer::Renderer(gfx::Context *ctx, GameState *state) : m_ctx(ctx), m_state(st
     m_ctx->device, quadVertices.size() * sizeof(QuadVertex), quadVertices.data()
   );
 
-  Extent3D textureSize = {m_state->fb_size.x, m_state->fb_size.y, 1};
-  TextureView depthTextureView =
-    util::CreateRenderTexture(m_ctx->device, textureSize, m_ctx->depthFormat)
-      .CreateView();
-
-  // shadow pass ----------------------------------------------
-  Extent3D shadowMapSize{4096, 4096, Sun::numCascades};
-  Texture shadowMapTextures = util::CreateRenderTexture(
-    m_ctx->device, shadowMapSize, TextureFormat::Depth32Float
+  m_nearestClampSampler = m_ctx->device.CreateSampler( //
+    ToPtr(SamplerDescriptor{
+      .addressModeU = AddressMode::ClampToEdge,
+      .addressModeV = AddressMode::ClampToEdge,
+      .magFilter = FilterMode::Nearest,
+      .minFilter = FilterMode::Nearest,
+    })
   );
-  TextureView shadowMapTexturesView = shadowMapTextures.CreateView();
 
-  for (size_t i = 0; i < Sun::numCascades; i++) {
-    TextureView textureView = shadowMapTextures.CreateView(ToPtr(TextureViewDescriptor{
-      .baseArrayLayer = static_cast<uint32_t>(i), .arrayLayerCount = 1
-    }));
+  // textures that outlive a frame are created here, the rest by the render graph
+  Extent3D textureSize = {m_state->fb_size.x, m_state->fb_size.y, 1};
+  m_depthTexture = m_ctx->device.CreateTexture(ToPtr(TextureDescriptor{
+    .usage = TextureUsage::RenderAttachment | TextureUsage::TextureBinding |
+             TextureUsage::CopySrc,
+    .size = textureSize,
+    .format = m_ctx->depthFormat,
+  }));
 
-    m_shadowPassDescs[i] = util::RenderPassDescriptor(
-      {},
-      {
-        .view = textureView,
-        .depthLoadOp = LoadOp::Clear,
-        .depthStoreOp = StoreOp::Store,
-        .depthClearValue = 1.0,
-      }
-    );
+  m_gpuCuller =
+    GpuCuller(m_ctx, m_state, m_depthTexture.CreateView(), m_state->fb_size);
+  m_gpuTimer = GpuTimer(m_ctx);
+  m_farTerrain = game::FarTerrain(m_ctx, m_state);
+  m_graph = RenderGraph(m_ctx);
 
+  // shadow pass ----------------------------------------------
+  // the atlas itself is created with the render graph, see CreateShadowAtlas
+  m_shadowRectsBuffer = util::CreateUniformBuffer(
+    m_ctx->device, sizeof(glm::vec4) * Sun::maxCascades
+  );
+  for (size_t i = 0; i < Sun::maxCascades; i++) {
     Buffer buffer = util::CreateUniformBuffer(ctx->device, sizeof(uint32_t), &i);
     m_cascadeIndicesBG[i] = dawn::utils::MakeBindGroup(
       ctx->device, ctx->pipeline.shadowBGL,
@@ -75,63 +84,12 @@ Renderer::Renderer(gfx::Context *ctx, GameState *state) : m_ctx(ctx), m_state(st
   }
 
   // gbuffer pass -----------------------------------------------------
-  // create textures: position (view-space), normal, color
-  std::array<wgpu::TextureView, 3> gBufferTextureViews{
-    util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::RGBA16Float)
-      .CreateView(),
-    util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::RGBA16Float)
-      .CreateView(),
-    util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::BGRA8Unorm)
-      .CreateView(),
-  };
-
-  // pass desc
-  m_gBufferPassDesc = dawn::utils::ComboRenderPassDescriptor(
-    {
-      gBufferTextureViews[0],
-      gBufferTextureViews[1],
-      gBufferTextureViews[2],
-    },
-    depthTextureView
-  );
-  m_gBufferPassDesc.UnsetDepthStencilLoadStoreOpsForFormat(ctx->depthFormat);
-  // position (view-space), normal, color
-  m_gBufferPassDesc.cColorAttachments[0].clearValue = {0.0, 0.0, -10000, 0.0};
-  m_gBufferPassDesc.cColorAttachments[1].clearValue = {0.0, 0.0, 0.0, 0.0};
-  m_gBufferPassDesc.cColorAttachments[2].clearValue = {0.5, 0.8, 0.9, 1.0};
-
-  // wire pass desc
-  m_gBufferWirePassDesc = dawn::utils::ComboRenderPassDescriptor(
-    {
-      gBufferTextureViews[0],
-      gBufferTextureViews[1],
-      gBufferTextureViews[2],
-    },
-    depthTextureView
-  );
-  m_gBufferWirePassDesc.UnsetDepthStencilLoadStoreOpsForFormat(ctx->depthFormat);
-  m_gBufferWirePassDesc.cDepthStencilAttachmentInfo.depthLoadOp = LoadOp::Load;
-  m_gBufferWirePassDesc.cDepthStencilAttachmentInfo.depthStoreOp = StoreOp::Discard;
-  // position (view-space), normal, color
-  m_gBufferWirePassDesc.cColorAttachments[0].clearValue = {0.0, 0.0, -10000, 0.0};
-  m_gBufferWirePassDesc.cColorAttachments[1].clearValue = {0.0, 0.0, 0.0, 0.0};
-  m_gBufferWirePassDesc.cColorAttachments[2].clearValue = {0.5, 0.8, 0.9, 1.0};
-
-  // depth pass desc
-  m_gBufferDepthPassDesc = dawn::utils::ComboRenderPassDescriptor({}, depthTextureView);
-  m_gBufferDepthPassDesc.UnsetDepthStencilLoadStoreOpsForFormat(ctx->depthFormat);
-
-  // water pass ---------------------------------------------------
-  TextureView waterTextureView =
-    util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::BGRA8Unorm)
-      .CreateView();
-
-  // pass desc
-  m_waterPassDesc =
-    dawn::utils::ComboRenderPassDescriptor({waterTextureView}, depthTextureView);
-  m_waterPassDesc.UnsetDepthStencilLoadStoreOpsForFormat(ctx->depthFormat);
-  m_waterPassDesc.cDepthStencilAttachmentInfo.depthLoadOp = LoadOp::Load;
-  m_waterPassDesc.cDepthStencilAttachmentInfo.depthStoreOp = StoreOp::Discard;
+  // the compact layout puts depth and the packed normal in the same slots
+  for (uint32_t compact = 0; compact < 2; compact++) {
+    m_gBufferParamsBuffers[compact] =
+      util::CreateUniformBuffer(m_ctx->device, sizeof(GBufferParams));
+  }
+  WriteGBufferParams();
 
   // ssao pass ---------------------------------------------------
   m_ssaoBuffer = util::CreateUniformBuffer(m_ctx->device, sizeof(m_ssao), &m_ssao);
@@ -174,16 +132,6 @@ Renderer::Renderer(gfx::Context *ctx, GameState *state) : m_ctx(ctx), m_state(st
     )
       .CreateView();
 
-  // samplers
-  Sampler nearestClampSampler = m_ctx->device.CreateSampler( //
-    ToPtr(SamplerDescriptor{
-      .addressModeU = AddressMode::ClampToEdge,
-      .addressModeV = AddressMode::ClampToEdge,
-      .magFilter = FilterMode::Nearest,
-      .minFilter = FilterMode::Nearest,
-    })
-  );
-
   Sampler noiseSampler = m_ctx->device.CreateSampler( //
     ToPtr(SamplerDescriptor{
       .addressModeU = AddressMode::Repeat,
@@ -193,16 +141,6 @@ Renderer::Renderer(gfx::Context *ctx, GameState *state) : m_ctx(ctx), m_state(st
     })
   );
 
-  m_gBufferBindGroup = dawn::utils::MakeBindGroup(
-    m_ctx->device, m_ctx->pipeline.gBufferBGL,
-    {
-      {0, gBufferTextureViews[0]},
-      {1, gBufferTextureViews[1]},
-      {2, gBufferTextureViews[2]},
-      {3, nearestClampSampler},
-    }
-  );
-
   m_ssaoSamplingBindGroup = dawn::utils::MakeBindGroup(
     m_ctx->device, m_ctx->pipeline.ssaoSamplingBGL,
     {
@@ -213,64 +151,688 @@ Renderer::Renderer(gfx::Context *ctx, GameState *state) : m_ctx(ctx), m_state(st
     }
   );
 
-  // ssao render textures, pre-blur and blurred
-  std::array<wgpu::TextureView, 2> ssaoTextureViews;
-  for (size_t i = 0; i < ssaoTextureViews.size(); i++) {
-    ssaoTextureViews[i] =
-      util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::R8Unorm)
-        .CreateView();
+  uint8_t white = 255;
+  m_whiteTexture =
+    util::CreateTexture(m_ctx->device, {1, 1, 1}, TextureFormat::R8Unorm, &white);
+
+  // temporal ssao ----------------------------------------------------
+  for (size_t i = 0; i < m_ssaoHistoryTextures.size(); i++) {
+    m_ssaoHistoryTextures[i] =
+      util::CreateRenderTexture(m_ctx->device, textureSize, TextureFormat::RGBA16Float);
+    TextureView historyView = m_ssaoHistoryTextures[i].CreateView();
+    m_ssaoHistoryPassDescs[i] = util::RenderPassDescriptor({
+      {
+        .view = historyView,
+        .loadOp = LoadOp::Clear,
+        .storeOp = StoreOp::Store,
+      },
+    });
+    m_ssaoHistoryBlurBindGroups[i] = dawn::utils::MakeBindGroup(
+      ctx->device, m_ctx->pipeline.ssaoTextureBGL,
+      {
+        {0, historyView},
+        {1, m_nearestClampSampler},
+      }
+    );
   }
 
-  // pass desc
-  m_ssaoPassDesc = util::RenderPassDescriptor({
-    {
-      .view = ssaoTextureViews[0],
+  // composite pass ---------------------------------------------------
+  m_shadowSampler = m_ctx->device.CreateSampler( //
+    ToPtr(SamplerDescriptor{
+      .compare = CompareFunction::Less,
+    })
+  );
+  CreateShadowAtlas();
+
+  m_compositePassDesc = {
+    .colorAttachmentCount = 1,
+    .colorAttachments = nullptr,
+  };
+}
+
+static util::RenderPassDescriptor ClearPassDesc(std::vector<TextureView> views) {
+  std::vector<RenderPassColorAttachment> colorAttachments;
+  for (auto &view : views) {
+    colorAttachments.push_back({
+      .view = view,
       .loadOp = LoadOp::Clear,
       .storeOp = StoreOp::Store,
-    },
+    });
+  }
+  return util::RenderPassDescriptor(colorAttachments);
+}
+
+// sky: far away position, normal.w and surface flag 0
+static void SetGBufferClearValues(
+  dawn::utils::ComboRenderPassDescriptor &passDesc, size_t targetCount, bool compact
+) {
+  for (size_t i = 0; i < targetCount; i++) {
+    passDesc.cColorAttachments[i].clearValue = {0.0, 0.0, 0.0, 0.0};
+  }
+  if (!compact) passDesc.cColorAttachments[0].clearValue = {0.0, 0.0, -10000, 0.0};
+  passDesc.cColorAttachments[targetCount - 1].clearValue = {0.5, 0.8, 0.9, 1.0};
+}
+
+// passes are added in the order they run. every ssao path is added, composite reads
+// the chosen path's result (or white with ssao off) and the others are culled
+void Renderer::BuildGraph() {
+  using Handle = RenderGraph::Handle;
+  m_graphDirty = false;
+  m_graph.Reset();
+  Extent3D size = {m_state->fb_size.x, m_state->fb_size.y, 1};
+  Extent3D halfSize = {(size.width + 1) / 2, (size.height + 1) / 2, 1};
+
+  Handle depth = m_graph.ImportTexture("Depth", m_depthTexture);
+  Handle shadowAtlas = m_graph.ImportTexture("Shadow Atlas", m_shadowAtlas);
+  std::array<Handle, 2> history = {
+    m_graph.ImportTexture("SSAO History 0", m_ssaoHistoryTextures[0]),
+    m_graph.ImportTexture("SSAO History 1", m_ssaoHistoryTextures[1]),
+  };
+  Handle white = m_graph.ImportTexture("White", m_whiteTexture);
+
+  // gpu culling -------------------------------------------------------
+  m_graph.AddPass({
+    .name = "GPU Cull",
+    .output = true, // indirect args, tracked outside the graph
+    .execute =
+      [this](const CommandEncoder &commandEncoder) {
+        if (m_gpuCulling) {
+          m_gpuCuller.Cull(commandEncoder, m_gpuTimer.ComputePass("GPU Cull"));
+        }
+      },
   });
 
-  // blur pass ---------------------------------------------------
-  // ssao texture bindgroups
-  for (size_t i = 0; i < m_ssaoTextureBindGroups.size(); i++) {
-    m_ssaoTextureBindGroups[i] = dawn::utils::MakeBindGroup(
-      ctx->device, m_ctx->pipeline.ssaoTextureBGL,
+  // shadow pass -------------------------------------------------------
+  m_graph.AddPass({
+    .name = "Shadow",
+    .reads = {shadowAtlas}, // cascades that aren't redrawn keep their contents
+    .writes = {shadowAtlas},
+    .execute = [this](const CommandEncoder &encoder) { ShadowPass(encoder); },
+  });
+
+  // gbuffer pass ------------------------------------------------------
+  Handle albedo = m_graph.CreateTexture("Albedo", {size, TextureFormat::BGRA8Unorm});
+  std::vector<Handle> gBufferTargets;
+  // what readers bind at gBufferBGL 0 to 2
+  std::vector<Handle> gBufferReads;
+  if (compactGBuffer) {
+    Handle normal =
+      m_graph.CreateTexture("Packed Normal", {size, TextureFormat::RGBA8Unorm});
+    Handle depthCopy = m_graph.CreateTexture(
+      "Depth Copy",
+      {size, m_ctx->depthFormat, TextureUsage::CopyDst | TextureUsage::TextureBinding}
+    );
+    gBufferTargets = {normal, albedo};
+    gBufferReads = {depthCopy, normal, albedo};
+  } else {
+    Handle position =
+      m_graph.CreateTexture("Position", {size, TextureFormat::RGBA16Float});
+    Handle normal = m_graph.CreateTexture("Normal", {size, TextureFormat::RGBA16Float});
+    gBufferTargets = {position, normal, albedo};
+    gBufferReads = gBufferTargets;
+  }
+  auto withGBuffer = [&](std::vector<Handle> handles) {
+    handles.insert(handles.end(), gBufferReads.begin(), gBufferReads.end());
+    return handles;
+  };
+  std::vector<Handle> gBufferWrites = gBufferTargets;
+  gBufferWrites.push_back(depth);
+
+  // pass descriptor and the readers' bind group
+  auto setupGBuffer = [this, gBufferTargets, gBufferReads](
+                        dawn::utils::ComboRenderPassDescriptor &passDesc, bool wire
+                      ) {
+    std::vector<TextureView> views;
+    for (Handle handle : gBufferTargets) views.push_back(m_graph.GetView(handle));
+    passDesc =
+      dawn::utils::ComboRenderPassDescriptor(views, m_depthTexture.CreateView());
+    passDesc.UnsetDepthStencilLoadStoreOpsForFormat(m_ctx->depthFormat);
+    if (wire) {
+      // on top of the depth prepass, water and hi-z read the result
+      passDesc.cDepthStencilAttachmentInfo.depthLoadOp = LoadOp::Load;
+    }
+    SetGBufferClearValues(passDesc, views.size(), compactGBuffer);
+
+    m_gBufferBindGroup = dawn::utils::MakeBindGroup(
+      m_ctx->device, m_ctx->pipeline.gBufferBGL,
       {
-        {0, ssaoTextureViews[i]},
-        {1, nearestClampSampler},
+        {0, m_graph.GetView(gBufferReads[0])},
+        {1, m_graph.GetView(gBufferReads[1])},
+        {2, m_graph.GetView(gBufferReads[2])},
+        {3, m_nearestClampSampler},
+        {4, m_gBufferParamsBuffers[compactGBuffer]},
       }
     );
+  };
+  if (!wireframe) {
+    m_graph.AddPass({
+      .name = "G-Buffer",
+      .writes = gBufferWrites,
+      .setup = [this, setupGBuffer] { setupGBuffer(m_gBufferPassDesc, false); },
+      .execute = [this](const CommandEncoder &encoder) { GBufferPass(encoder); },
+    });
+  } else {
+    m_graph.AddPass({
+      .name = "Depth Prepass",
+      .writes = {depth},
+      .setup =
+        [this] {
+          m_gBufferDepthPassDesc = dawn::utils::ComboRenderPassDescriptor(
+            {}, m_depthTexture.CreateView()
+          );
+          m_gBufferDepthPassDesc.UnsetDepthStencilLoadStoreOpsForFormat(
+            m_ctx->depthFormat
+          );
+        },
+      .execute =
+        [this](const CommandEncoder &commandEncoder) {
+          m_gBufferDepthPassDesc.timestampWrites =
+            m_gpuTimer.RenderPass("Depth Prepass");
+          RenderPassEncoder passEncoder =
+            commandEncoder.BeginRenderPass(&m_gBufferDepthPassDesc);
+          ExecuteChunkBundle(
+            "Depth Prepass", passEncoder, m_gBufferDepthBundle, BundleKey(0, 0), {},
+            m_ctx->depthFormat,
+            [&](const RenderBundleEncoder &bundleEncoder) {
+              bundleEncoder.SetPipeline(m_ctx->pipeline.gBufferDepthRPL);
+              bundleEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
+              bundleEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
+              m_state->chunkManager.RenderDepth(bundleEncoder, 2);
+            }
+          );
+          passEncoder.End();
+        },
+    });
+    m_graph.AddPass({
+      .name = "G-Buffer Wire",
+      .reads = {depth},
+      .writes = gBufferWrites,
+      .setup = [this, setupGBuffer] { setupGBuffer(m_gBufferWirePassDesc, true); },
+      .execute = [this](const CommandEncoder &encoder) { GBufferWirePass(encoder); },
+    });
+  }
+  // opaque depth is complete, occlusion for next frame is tested against it
+  m_graph.AddPass({
+    .name = "Hi-Z",
+    .reads = {depth},
+    .output = true,
+    .execute =
+      [this](const CommandEncoder &commandEncoder) {
+        if (m_gpuCulling) {
+          m_gpuCuller.BuildHiZ(commandEncoder, m_gpuTimer.ComputePass("Hi-Z"));
+        }
+      },
+  });
+  // water draws into the depth buffer too, compact readers get a copy of it as
+  // the gbuffer left it
+  if (compactGBuffer) {
+    Handle depthCopy = gBufferReads[0];
+    m_graph.AddPass({
+      .name = "Depth Copy",
+      .reads = {depth},
+      .writes = {depthCopy},
+      .execute =
+        [this, depthCopy, size](const CommandEncoder &commandEncoder) {
+          commandEncoder.CopyTextureToTexture(
+            ToPtr(ImageCopyTexture{.texture = m_depthTexture}),
+            ToPtr(ImageCopyTexture{.texture = m_graph.GetTexture(depthCopy)}), &size
+          );
+        },
+    });
   }
 
-  m_blurPassDesc = util::RenderPassDescriptor({
-    {
-      .view = ssaoTextureViews[1],
-      .loadOp = LoadOp::Clear,
-      .storeOp = StoreOp::Store,
-    },
+  // water pass --------------------------------------------------------
+  Handle water = m_graph.CreateTexture("Water", {size, TextureFormat::BGRA8Unorm});
+  m_graph.AddPass({
+    .name = "Water",
+    .reads = {depth},
+    .writes = {water},
+    .setup =
+      [this, water] {
+        m_waterPassDesc = dawn::utils::ComboRenderPassDescriptor(
+          {m_graph.GetView(water)}, m_depthTexture.CreateView()
+        );
+        m_waterPassDesc.UnsetDepthStencilLoadStoreOpsForFormat(m_ctx->depthFormat);
+        m_waterPassDesc.cDepthStencilAttachmentInfo.depthLoadOp = LoadOp::Load;
+        m_waterPassDesc.cDepthStencilAttachmentInfo.depthStoreOp = StoreOp::Discard;
+      },
+    .execute = [this](const CommandEncoder &encoder) { WaterPass(encoder); },
   });
 
-  // composite pass ---------------------------------------------------
-  Sampler shadowSampler = m_ctx->device.CreateSampler( //
-    ToPtr(SamplerDescriptor{
-      .compare = CompareFunction::Less,
-    })
+  // ssao, timed under the path's name so the paths can be compared ------
+  BindGroup cameraBindGroup = m_state->player.camera.bindGroup;
+
+  // blends the path's raw ao into this frame's history, which the blur reads after.
+  // last frame's history is the other texture, nothing this frame writes it first
+  auto addTemporalPass = [&](size_t path, Handle raw) {
+    m_graph.AddPass({
+      .name = "SSAO Temporal",
+      .reads = withGBuffer({raw}),
+      .writes = {history[0], history[1]},
+      .setup =
+        [this, path, raw] {
+          for (size_t i = 0; i < m_ssaoTemporalBindGroups[path].size(); i++) {
+            m_ssaoTemporalBindGroups[path][i] = dawn::utils::MakeBindGroup(
+              m_ctx->device, m_ctx->pipeline.ssaoTemporalBGL,
+              {
+                {0, m_graph.GetView(raw)},
+                {1, m_ssaoHistoryTextures[1 - i].CreateView()},
+              }
+            );
+          }
+        },
+      .execute =
+        [this, path, cameraBindGroup](const CommandEncoder &encoder) {
+          if (!m_ssaoHistoryValid) {
+            // cleared history is rejected everywhere
+            encoder.BeginRenderPass(&m_ssaoHistoryPassDescs[1 - m_ssaoHistory]).End();
+            m_ssaoHistoryValid = true;
+          }
+          QuadPass(
+            encoder, "SSAO Temporal", m_ssaoHistoryPassDescs[m_ssaoHistory],
+            m_ctx->pipeline.ssaoTemporalRPL,
+            {cameraBindGroup, m_gBufferBindGroup,
+             m_ssaoTemporalBindGroups[path][m_ssaoHistory]}
+          );
+        },
+    });
+  };
+  bool temporal = ssaoTemporal;
+
+  // fragment path
+  Handle ssaoRaw = m_graph.CreateTexture("SSAO", {size, TextureFormat::R8Unorm});
+  Handle ssaoBlurred =
+    m_graph.CreateTexture("SSAO Blurred", {size, TextureFormat::R8Unorm});
+  m_graph.AddPass({
+    .name = "SSAO Fragment",
+    .reads = gBufferReads,
+    .writes = {ssaoRaw},
+    .setup =
+      [this, ssaoRaw] {
+        TextureView view = m_graph.GetView(ssaoRaw);
+        m_ssaoPassDesc = ClearPassDesc({view});
+        m_ssaoTextureBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoTextureBGL,
+          {
+            {0, view},
+            {1, m_nearestClampSampler},
+          }
+        );
+      },
+    .execute =
+      [this, cameraBindGroup](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Fragment", m_ssaoPassDesc, m_ctx->pipeline.ssaoRPL,
+          {cameraBindGroup, m_gBufferBindGroup, m_ssaoSamplingBindGroup}
+        );
+      },
+  });
+  if (temporal) addTemporalPass(0, ssaoRaw);
+  m_graph.AddPass({
+    .name = "SSAO Fragment Blur",
+    .reads = temporal ? std::vector<Handle>{history[0], history[1]}
+                      : std::vector<Handle>{ssaoRaw},
+    .writes = {ssaoBlurred},
+    .setup =
+      [this, ssaoBlurred] {
+        m_blurPassDesc = ClearPassDesc({m_graph.GetView(ssaoBlurred)});
+      },
+    .execute =
+      [this, temporal](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Fragment Blur", m_blurPassDesc, m_ctx->pipeline.blurRPL,
+          {temporal ? m_ssaoHistoryBlurBindGroups[m_ssaoHistory]
+                    : m_ssaoTextureBindGroup}
+        );
+      },
+  });
+
+  // half resolution path
+  Handle halfPosition =
+    m_graph.CreateTexture("Half Position", {halfSize, TextureFormat::RGBA16Float});
+  Handle halfNormal =
+    m_graph.CreateTexture("Half Normal", {halfSize, TextureFormat::RGBA16Float});
+  Handle halfAo =
+    m_graph.CreateTexture("Half SSAO", {halfSize, TextureFormat::R8Unorm});
+  Handle halfBlurred =
+    m_graph.CreateTexture("Half SSAO Blurred", {halfSize, TextureFormat::R8Unorm});
+  Handle ssaoUpsampled =
+    m_graph.CreateTexture("SSAO Upsampled", {size, TextureFormat::R8Unorm});
+  m_graph.AddPass({
+    .name = "SSAO Downsample",
+    .reads = gBufferReads,
+    .writes = {halfPosition, halfNormal},
+    .setup =
+      [this, halfPosition, halfNormal, albedo] {
+        TextureView positionView = m_graph.GetView(halfPosition);
+        TextureView normalView = m_graph.GetView(halfNormal);
+        m_ssaoDownsamplePassDesc = ClearPassDesc({positionView, normalView});
+        // albedo isn't read by ssao, the full resolution one fills the slot. the
+        // downsample always writes the full layout
+        m_halfGBufferBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.gBufferBGL,
+          {
+            {0, positionView},
+            {1, normalView},
+            {2, m_graph.GetView(albedo)},
+            {3, m_nearestClampSampler},
+            {4, m_gBufferParamsBuffers[0]},
+          }
+        );
+      },
+    .execute =
+      [this](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Downsample", m_ssaoDownsamplePassDesc,
+          m_ctx->pipeline.ssaoDownsampleRPL, {m_gBufferBindGroup}
+        );
+      },
+  });
+  m_graph.AddPass({
+    .name = "SSAO Half Res",
+    .reads = {halfPosition, halfNormal, albedo},
+    .writes = {halfAo},
+    .setup =
+      [this, halfAo] {
+        TextureView view = m_graph.GetView(halfAo);
+        m_ssaoHalfPassDesc = ClearPassDesc({view});
+        m_ssaoHalfTextureBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoTextureBGL,
+          {
+            {0, view},
+            {1, m_nearestClampSampler},
+          }
+        );
+      },
+    .execute =
+      [this, cameraBindGroup](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Half Res", m_ssaoHalfPassDesc, m_ctx->pipeline.ssaoRPL,
+          {cameraBindGroup, m_halfGBufferBindGroup, m_ssaoSamplingBindGroup}
+        );
+      },
+  });
+  m_graph.AddPass({
+    .name = "SSAO Half Res Blur",
+    .reads = {halfAo},
+    .writes = {halfBlurred},
+    .setup =
+      [this, halfBlurred] {
+        m_blurHalfPassDesc = ClearPassDesc({m_graph.GetView(halfBlurred)});
+      },
+    .execute =
+      [this](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Half Res Blur", m_blurHalfPassDesc, m_ctx->pipeline.blurRPL,
+          {m_ssaoHalfTextureBindGroup}
+        );
+      },
+  });
+  m_graph.AddPass({
+    .name = "SSAO Upsample",
+    .reads = withGBuffer({halfBlurred, halfPosition, halfNormal}),
+    .writes = {ssaoUpsampled},
+    .setup =
+      [this, halfBlurred, halfPosition, halfNormal, ssaoUpsampled] {
+        m_ssaoUpsampleBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoUpsampleBGL,
+          {
+            {0, m_graph.GetView(halfBlurred)},
+            {1, m_graph.GetView(halfPosition)},
+            {2, m_graph.GetView(halfNormal)},
+          }
+        );
+        m_ssaoUpsamplePassDesc = ClearPassDesc({m_graph.GetView(ssaoUpsampled)});
+      },
+    .execute =
+      [this](const CommandEncoder &encoder) {
+        QuadPass(
+          encoder, "SSAO Upsample", m_ssaoUpsamplePassDesc,
+          m_ctx->pipeline.ssaoUpsampleRPL, {m_gBufferBindGroup, m_ssaoUpsampleBindGroup}
+        );
+      },
+  });
+
+  // compute path, r8 can't be a storage texture. the blurred result can share the
+  // raw ao's texture
+  RenderGraph::TextureDesc computeDesc = {
+    size, TextureFormat::R32Float,
+    TextureUsage::StorageBinding | TextureUsage::TextureBinding
+  };
+  Handle computeRaw = m_graph.CreateTexture("SSAO Compute", computeDesc);
+  Handle computeRows = m_graph.CreateTexture("SSAO Compute Rows", computeDesc);
+  Handle computeBlurred = m_graph.CreateTexture("SSAO Compute Blurred", computeDesc);
+  auto groups = [](uint32_t size, uint32_t groupSize) {
+    return (size + groupSize - 1) / groupSize;
+  };
+  m_graph.AddPass({
+    .name = "SSAO Compute",
+    .reads = gBufferReads,
+    .writes = {computeRaw},
+    .setup =
+      [this, computeRaw] {
+        m_ssaoOutputBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoOutputBGL,
+          {
+            {0, m_graph.GetView(computeRaw)},
+          }
+        );
+      },
+    .execute =
+      [this, size, groups, cameraBindGroup](const CommandEncoder &encoder) {
+        ComputePassEncoder passEncoder =
+          encoder.BeginComputePass(ToPtr(ComputePassDescriptor{
+            .timestampWrites = m_gpuTimer.ComputePass("SSAO Compute"),
+          }));
+        passEncoder.SetPipeline(m_ctx->pipeline.ssaoCPL);
+        passEncoder.SetBindGroup(0, cameraBindGroup);
+        passEncoder.SetBindGroup(1, m_gBufferBindGroup);
+        passEncoder.SetBindGroup(2, m_ssaoSamplingBindGroup);
+        passEncoder.SetBindGroup(3, m_ssaoOutputBindGroup);
+        passEncoder.DispatchWorkgroups(groups(size.width, 8), groups(size.height, 8));
+        passEncoder.End();
+      },
+  });
+  if (temporal) addTemporalPass(1, computeRaw);
+  m_graph.AddPass({
+    .name = "SSAO Compute Blur Rows",
+    .reads = withGBuffer(
+      temporal ? std::vector<Handle>{history[0], history[1]}
+               : std::vector<Handle>{computeRaw}
+    ),
+    .writes = {computeRows},
+    .setup =
+      [this, computeRaw, computeRows] {
+        TextureView rowsView = m_graph.GetView(computeRows);
+        m_ssaoBlurBindGroups[0] = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoBlurBGL,
+          {
+            {0, m_graph.GetView(computeRaw)},
+            {1, rowsView},
+          }
+        );
+        for (size_t i = 0; i < m_ssaoHistoryComputeBlurBindGroups.size(); i++) {
+          m_ssaoHistoryComputeBlurBindGroups[i] = dawn::utils::MakeBindGroup(
+            m_ctx->device, m_ctx->pipeline.ssaoBlurBGL,
+            {
+              {0, m_ssaoHistoryTextures[i].CreateView()},
+              {1, rowsView},
+            }
+          );
+        }
+      },
+    .execute =
+      [this, size, groups, temporal](const CommandEncoder &encoder) {
+        ComputePassEncoder passEncoder =
+          encoder.BeginComputePass(ToPtr(ComputePassDescriptor{
+            .timestampWrites = m_gpuTimer.ComputePass("SSAO Compute Blur"),
+          }));
+        passEncoder.SetBindGroup(0, m_gBufferBindGroup);
+        passEncoder.SetPipeline(m_ctx->pipeline.blurHorizontalCPL);
+        passEncoder.SetBindGroup(
+          1, temporal ? m_ssaoHistoryComputeBlurBindGroups[m_ssaoHistory]
+                      : m_ssaoBlurBindGroups[0]
+        );
+        passEncoder.DispatchWorkgroups(groups(size.width, 64), size.height);
+        passEncoder.End();
+      },
+  });
+  m_graph.AddPass({
+    .name = "SSAO Compute Blur Columns",
+    .reads = withGBuffer({computeRows}),
+    .writes = {computeBlurred},
+    .setup =
+      [this, computeRows, computeBlurred] {
+        m_ssaoBlurBindGroups[1] = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.ssaoBlurBGL,
+          {
+            {0, m_graph.GetView(computeRows)},
+            {1, m_graph.GetView(computeBlurred)},
+          }
+        );
+      },
+    .execute =
+      [this, size, groups](const CommandEncoder &encoder) {
+        ComputePassEncoder passEncoder =
+          encoder.BeginComputePass(ToPtr(ComputePassDescriptor{
+            .timestampWrites = m_gpuTimer.ComputePass("SSAO Compute Blur"),
+          }));
+        passEncoder.SetBindGroup(0, m_gBufferBindGroup);
+        passEncoder.SetPipeline(m_ctx->pipeline.blurVerticalCPL);
+        passEncoder.SetBindGroup(1, m_ssaoBlurBindGroups[1]);
+        passEncoder.DispatchWorkgroups(size.width, groups(size.height, 64));
+        passEncoder.End();
+      },
+  });
+
+  // composite pass ----------------------------------------------------
+  Handle ao = white;
+  if (m_ssao.enabled) {
+    switch (ssaoPath) {
+    case SsaoPath::Fragment:
+      ao = ssaoBlurred;
+      break;
+    case SsaoPath::HalfRes:
+      ao = ssaoUpsampled;
+      break;
+    case SsaoPath::Compute:
+      ao = computeBlurred;
+      break;
+    }
+  }
+  m_graph.AddPass({
+    .name = "Composite",
+    .reads = withGBuffer({water, ao, shadowAtlas}),
+    .output = true, // to the swap chain
+    .setup =
+      [this, water, ao] {
+        m_compositeBindGroup = dawn::utils::MakeBindGroup(
+          m_ctx->device, m_ctx->pipeline.compositeBGL,
+          {
+            {0, m_graph.GetView(ao)},
+            {1, m_graph.GetView(water)},
+            {2, m_shadowAtlasView},
+            {3, m_shadowSampler},
+            {4, m_shadowRectsBuffer},
+          }
+        );
+      },
+    .execute = [this](const CommandEncoder &encoder) { CompositePass(encoder); },
+  });
+
+  m_graph.Compile();
+}
+
+// shelf packs the square maps largest first, in rows as wide as the two largest.
+// returns the atlas size
+static glm::uvec2 PackShadowAtlas(
+  const ShadowSettings &settings, std::array<glm::uvec3, Sun::maxCascades> &rects
+) {
+  int count = settings.numCascades;
+  auto &sizes = settings.resolutions;
+  std::array<int, Sun::maxCascades> order;
+  std::iota(order.begin(), order.begin() + count, 0);
+  std::stable_sort(order.begin(), order.begin() + count, [&](int a, int b) {
+    return sizes[a] > sizes[b];
+  });
+
+  uint32_t width = sizes[order[0]] + (count > 1 ? sizes[order[1]] : 0);
+  glm::uvec2 cursor(0), extent(0);
+  uint32_t rowHeight = 0;
+  for (int n = 0; n < count; n++) {
+    uint32_t size = sizes[order[n]];
+    if (cursor.x + size > width) {
+      cursor = glm::uvec2(0, cursor.y + rowHeight);
+      rowHeight = 0;
+    }
+    rects[order[n]] = glm::uvec3(cursor, size);
+    rowHeight = std::max(rowHeight, size);
+    cursor.x += size;
+    extent = glm::max(extent, glm::uvec2(cursor.x, cursor.y + size));
+  }
+  return extent;
+}
+
+void Renderer::CreateShadowAtlas() {
+  auto &settings = m_shadowSettings;
+  SupportedLimits limits;
+  m_ctx->device.GetLimits(&limits);
+  uint32_t maxSize = limits.limits.maxTextureDimension2D;
+
+  // too big for the device, halve the farthest of the largest maps until it fits.
+  // every webgpu device fits the smallest maps (maxTextureDimension2D >= 8192)
+  while (true) {
+    m_shadowAtlasSize = PackShadowAtlas(settings, m_shadowRects);
+    if (m_shadowAtlasSize.x <= maxSize && m_shadowAtlasSize.y <= maxSize) break;
+    int largest = 0;
+    for (int i = 1; i < settings.numCascades; i++) {
+      if (settings.resolutions[i] >= settings.resolutions[largest]) largest = i;
+    }
+    if (settings.resolutions[largest] <= ShadowSettings::minResolution) break;
+    settings.resolutions[largest] /= 2;
+  }
+
+  auto format =
+    settings.depth16 ? TextureFormat::Depth16Unorm : TextureFormat::Depth32Float;
+  if (format != m_ctx->pipeline.shadowFormat) {
+    m_ctx->pipeline.CreateShadowPipelines(m_ctx->device, format);
+  }
+  m_shadowAtlas = util::CreateRenderTexture(
+    m_ctx->device, {m_shadowAtlasSize.x, m_shadowAtlasSize.y, 1}, format
   );
+  m_shadowAtlasView = m_shadowAtlas.CreateView();
 
-  m_compositeBindGroup = dawn::utils::MakeBindGroup(
-    m_ctx->device, m_ctx->pipeline.compositeBGL,
+  // cascades clear their own rect, the rest of the atlas has to survive the pass
+  m_shadowPassDesc = util::RenderPassDescriptor(
+    {},
     {
-      {0, ssaoTextureViews[1]},
-      {1, waterTextureView},
-      {2, shadowMapTexturesView},
-      {3, shadowSampler},
+      .view = m_shadowAtlasView,
+      .depthLoadOp = LoadOp::Load,
+      .depthStoreOp = StoreOp::Store,
     }
   );
 
-  m_compositePassDesc = {
-    .colorAttachmentCount = 1,
-    .colorAttachments = nullptr,
-  };
+  std::array<glm::vec4, Sun::maxCascades> uvRects{};
+  for (int i = 0; i < settings.numCascades; i++) {
+    glm::vec2 corner(m_shadowRects[i].x, m_shadowRects[i].y);
+    uvRects[i] = glm::vec4(corner, glm::vec2(m_shadowRects[i].z)) /
+                 glm::vec4(m_shadowAtlasSize, m_shadowAtlasSize);
+  }
+  util::WriteBuffer(
+    m_ctx->queue, m_shadowRectsBuffer, 0, uvRects.data(),
+    sizeof(glm::vec4) * uvRects.size()
+  );
+
+  // composite samples the atlas
+  m_graphDirty = true;
+
+  // a new texture has nothing in it, and the projections snap to its texels
+  for (int i = 0; i < settings.numCascades; i++) {
+    m_state->sun.resolutions[i] = m_shadowRects[i].z;
+  }
+  m_state->sun.SetNumCascades(settings.numCascades);
+  m_state->sun.InvokeUpdate();
+  m_state->sun.InvalidateShadows();
 }
 
 void Renderer::ImguiRender() {
@@ -281,22 +843,106 @@ void Renderer::ImguiRender() {
   if (m_state->showStats) {
     ImGui::Begin("Statistics");
     {
-      const int NUM_FRAMES = 200;
-      static float frameTimes[NUM_FRAMES] = {};
-      static int frameTimeIndex = 0;
-
-      frameTimes[frameTimeIndex] = m_state->dt;
-      frameTimeIndex = (frameTimeIndex + 1) % NUM_FRAMES;
-
+      auto &frameStats = util::frameStats;
+      auto &percentiles = frameStats.GetPercentiles();
       ImGui::Text("FPS: %.3f", m_state->fps);
-      ImGui::Text("Frame Times");
+      ImGui::Text(
+        "Frame Time: %.2f p50, %.2f p95, %.2f p99, %.2f max (ms)", percentiles.p50,
+        percentiles.p95, percentiles.p99, percentiles.max
+      );
       ImGui::PlotHistogram(
-        "##Frame Times", frameTimes, NUM_FRAMES, frameTimeIndex, nullptr, 0.0f,
-        0.033333f, ImVec2(ImGui::GetWindowSize().x - 20, 150)
+        "##Frame Times", frameStats.GetFrameTimes(), util::FrameStats::windowSize,
+        frameStats.GetFrameOffset(), nullptr, 0.0f, 33.3333f,
+        ImVec2(ImGui::GetWindowSize().x - 20, 150)
       );
+
+      // the frame before this one
+      auto &counters = frameStats.last;
+      ImGui::Text(
+        "Chunks: %zu generated, %zu meshed, %zu faces", counters.chunksGenerated,
+        counters.chunksMeshed, counters.facesEmitted
+      );
+      ImGui::Text("Uploaded: %.1f KB", counters.bytesUploaded / 1024.0);
+      for (auto &[pass, draws] : counters.Passes()) {
+        ImGui::Text("Draw Calls (%s): %zu", pass, draws);
+      }
+      ImGui::Text("Visible Chunks (camera): %zu", counters.visibleChunks[0]);
+      for (int i = 0; i < m_state->sun.GetNumCascades(); i++) {
+        ImGui::Text(
+          "Visible Chunks (cascade %d): %zu", i, counters.visibleChunks[1 + i]
+        );
+      }
+      bool logging = frameStats.Logging();
+      if (ImGui::Checkbox("Log to frame_stats.jsonl", &logging)) {
+        if (logging) {
+          frameStats.StartLog("frame_stats.jsonl", 1.0);
+        } else {
+          frameStats.StopLog();
+        }
+      }
       ImGui::Text(
         "Position: %s", glm::to_string(m_state->player.GetPosition()).c_str()
       );
+      ImGui::Text("Remesh Backlog: %zu", m_state->chunkManager.remeshBacklog);
+      ImGui::Text("Remesh Overruns: %zu", m_state->chunkManager.remeshOverruns);
+      ImGui::Text("Bundles Recorded: %zu", m_bundlesRecorded);
+      ImGui::Text(
+        "Render Graph: %zu passes (%zu culled), %.1f MB transient (%.1f MB allocated)",
+        m_graph.GetPasses().size(), m_graph.culledPasses,
+        m_graph.transientBytes / (1024.0 * 1024.0),
+        m_graph.allocatedBytes / (1024.0 * 1024.0)
+      );
+      ImGui::Text(
+        "Shadow Passes: %zu (%zu chunk draws)", m_shadowPasses, m_shadowDraws
+      );
+      for (int i = 0; i < m_state->sun.GetNumCascades(); i++) {
+        auto casters = m_state->chunkManager.CulledCount(1 + i);
+        ImGui::Text("Casters (cascade %d): %zu chunks", i, casters);
+      }
+      ImGui::Text("Cave Culled: %zu chunks", m_state->chunkManager.caveCulled);
+      ImGui::Text(
+        "Occlusion Culled: %zu chunks (%.3f ms)",
+        m_state->chunkManager.occlusionCulled, m_state->chunkManager.occlusionTime
+      );
+      for (int lod = 0; lod <= game::Chunk::maxLod; lod++) {
+        auto &stats = m_state->chunkManager.lodStats[lod];
+        ImGui::Text(
+          "LOD %d: %zu chunks, %zu faces, %.2f MB", lod, stats.chunks, stats.faces,
+          stats.bytes / (1024.0 * 1024.0)
+        );
+      }
+      if (m_farTerrain.enabled) {
+        ImGui::Text("Far Terrain Triangles: %zu", m_farTerrain.triangles);
+      }
+      auto &cameraTris = m_state->chunkManager.cameraTriangles;
+      auto &shadowTris = m_state->chunkManager.shadowTriangles;
+      ImGui::Text(
+        "Triangles: %zu / %zu (camera)", cameraTris.submitted, cameraTris.total
+      );
+      ImGui::Text(
+        "Triangles: %zu / %zu (shadow)", shadowTris.submitted, shadowTris.total
+      );
+      if (m_gpuTimer.Available()) {
+        ImGui::Text("GPU Passes: %.3f ms", m_gpuTimer.frameAverage);
+        for (auto &[name, ms] : m_gpuTimer.averages) {
+          ImGui::Text("GPU %s: %.3f ms", name.c_str(), ms);
+        }
+        if (ImGui::Button("Export CSV")) m_gpuTimer.ExportCsv("gpu_timings.csv");
+        ImGui::SameLine();
+        if (ImGui::Button("Export JSON")) m_gpuTimer.ExportJson("gpu_timings.json");
+      } else {
+        ImGui::Text("GPU timings unavailable (no timestamp queries)");
+      }
+      if (ImGui::Button("Dump CPU Trace")) util::Profiler::DumpTrace("cpu_trace.json");
+      if (m_gpuCuller.enabled) {
+        auto &counts = m_gpuCuller.drawCounts;
+        ImGui::Text(
+          "GPU Draws: %u opaque, %u water", counts[0].opaque, counts[0].water
+        );
+        for (size_t i = 1; i < GpuCuller::numViews; i++) {
+          ImGui::Text("GPU Draws (cascade %zu): %u", i - 1, counts[i].opaque);
+        }
+      }
     }
     ImGui::End();
   }
@@ -311,13 +957,15 @@ void Renderer::ImguiRender() {
 
     ImGui::Begin("Options");
     {
-      ImGui::Checkbox("Wireframe", &wireframe);
+      m_graphDirty |= ImGui::Checkbox("Wireframe", &wireframe);
+      m_graphDirty |= ImGui::Checkbox("Compact G-Buffer", &compactGBuffer);
 
       // ssao options ---------------------------------------------
       bool tempEnabled = m_ssao.enabled;
       if (ImGui::Checkbox("##Hidden", &tempEnabled)) {
         m_ssao.enabled = tempEnabled;
         WRITE_SSAO_BUFFER(enabled);
+        m_graphDirty = true;
       }
       ImGui::SameLine();
       if (ImGui::CollapsingHeader("SSAO")) {
@@ -331,10 +979,22 @@ void Renderer::ImguiRender() {
         if (ImGui::SliderFloat("Bias", &m_ssao.bias, 0.0, 5.0)) {
           WRITE_SSAO_BUFFER(bias);
         }
+        static const char *pathNames[] = {"Fragment", "Half Resolution", "Compute"};
+        int pathIndex = int(ssaoPath);
+        if (ImGui::Combo("Path", &pathIndex, pathNames, IM_ARRAYSIZE(pathNames))) {
+          ssaoPath = SsaoPath(pathIndex);
+          m_graphDirty = true;
+        }
+        if (ssaoPath != SsaoPath::HalfRes) {
+          m_graphDirty |= ImGui::Checkbox("Temporal", &ssaoTemporal);
+        }
         // center the button relative to the sliders
         if (ImGui::Button("Reset")) {
           m_ssao.SetDefault();
-          m_ctx->queue.WriteBuffer(m_ssaoBuffer, 0, &m_ssao, sizeof(m_ssao));
+          util::WriteBuffer(
+            m_ctx->queue, m_ssaoBuffer, 0, &m_ssao, sizeof(m_ssao)
+          );
+          m_graphDirty = true;
         }
       }
 
@@ -348,6 +1008,24 @@ void Renderer::ImguiRender() {
             m_state->chunkManager.max_gens = 1;
           }
         }
+        ImGui::DragFloat(
+          "Remesh Budget (ms)", &m_state->chunkManager.remeshBudget, 0.1, 0.1, 33.0
+        );
+        ImGui::Checkbox("LOD", &m_state->chunkManager.lodEnabled);
+        if (m_state->chunkManager.lodEnabled) {
+          ImGui::DragInt2("LOD Rings", m_state->chunkManager.lodRings.data(), 1, 1, 64);
+        }
+        ImGui::Checkbox("Face Culling", &m_state->chunkManager.faceCulling);
+        ImGui::Checkbox("Cave Culling", &m_state->chunkManager.caveCulling);
+        ImGui::Checkbox("Far Terrain", &m_farTerrain.enabled);
+        ImGui::Checkbox("Occlusion Culling", &m_state->chunkManager.occlusionCulling);
+        if (m_state->chunkManager.occlusionCulling) {
+          ImGui::SliderInt("Occluders", &m_state->chunkManager.maxOccluders, 1, 512);
+        }
+        ImGui::Checkbox("GPU Culling", &m_gpuCuller.enabled);
+        if (m_gpuCuller.enabled) {
+          ImGui::Checkbox("Occlusion (Hi-Z)", &m_gpuCuller.occlusion);
+        }
       }
 
       // sun options -------------------------------------------------
@@ -358,6 +1036,51 @@ void Renderer::ImguiRender() {
         if (ImGui::SliderFloat("Turn", &m_state->sun.riseTurn.y, 0, 360)) {
           m_state->sun.InvokeUpdate();
         }
+        ImGui::SliderInt(
+          "Cascades Per Frame", &m_state->sun.cascadesPerFrame, 1, Sun::maxCascades - 1
+        );
+      }
+
+      // shadow options ----------------------------------------------
+      if (ImGui::CollapsingHeader("Shadows")) {
+        auto &settings = m_shadowSettings;
+        bool changed =
+          ImGui::SliderInt("Cascades", &settings.numCascades, 1, Sun::maxCascades);
+        static const char *sizeNames[] = {"512", "1024", "2048", "4096", "8192"};
+        for (int i = 0; i < settings.numCascades; i++) {
+          int sizeIndex = std::countr_zero(
+            uint32_t(settings.resolutions[i] / ShadowSettings::minResolution)
+          );
+          auto label = "Cascade " + std::to_string(i);
+          if (ImGui::Combo(
+                label.c_str(), &sizeIndex, sizeNames, IM_ARRAYSIZE(sizeNames)
+              )) {
+            settings.resolutions[i] = ShadowSettings::minResolution << sizeIndex;
+            changed = true;
+          }
+        }
+        changed |= ImGui::Checkbox("16-bit Depth", &settings.depth16);
+        if (changed) CreateShadowAtlas();
+
+        // each split stays past the one before it
+        auto &splits = m_state->sun.splits;
+        for (int i = 0; i < settings.numCascades; i++) {
+          float min = i > 0 ? splits[i - 1] + 1 : 1;
+          auto label = "Split " + std::to_string(i);
+          if (ImGui::DragFloat(label.c_str(), &splits[i], 1, min, 2000, "%.0f")) {
+            splits[i] = std::max(splits[i], min);
+            for (int j = i + 1; j < Sun::maxCascades; j++) {
+              splits[j] = std::max(splits[j], splits[j - 1] + 1);
+            }
+            m_state->sun.InvokeUpdate();
+          }
+        }
+
+        size_t texelBytes = settings.depth16 ? 2 : 4;
+        ImGui::Text(
+          "Atlas: %ux%u (%.1f MB)", m_shadowAtlasSize.x, m_shadowAtlasSize.y,
+          m_shadowAtlasSize.x * m_shadowAtlasSize.y * texelBytes / (1024.0 * 1024.0)
+        );
       }
     }
     ImGui::End();
@@ -365,8 +1088,29 @@ void Renderer::ImguiRender() {
   ImGui::Render();
 }
 
+void Renderer::WriteGBufferParams() {
+  m_gBufferProjection = m_state->player.camera.GetProjection();
+  for (uint32_t compact = 0; compact < 2; compact++) {
+    GBufferParams params{
+      .inverseProjection = glm::inverse(m_gBufferProjection),
+      .compact = compact,
+    };
+    util::WriteBuffer(
+      m_ctx->queue, m_gBufferParamsBuffers[compact], 0, &params, sizeof(params)
+    );
+  }
+}
+
 void Renderer::Render() {
-  ImguiRender();
+  PROFILE_ZONE("Renderer::Render");
+  {
+    PROFILE_ZONE("ImGui");
+    ImguiRender();
+  }
+  if (m_graphDirty) {
+    PROFILE_ZONE("Build Graph");
+    BuildGraph();
+  }
 
   TextureView nextTexture = m_ctx->swapChain.GetCurrentTextureView();
   if (!nextTexture) {
@@ -382,115 +1126,249 @@ void Renderer::Render() {
   };
   m_compositePassDesc.colorAttachments = &colorAttachment;
 
+  m_farTerrain.Update();
+
   CommandEncoder commandEncoder = m_ctx->device.CreateCommandEncoder();
-  // shadow pass
-  if (m_state->sun.ShouldRenderFirst()) {
-    int i = 0;
-    RenderPassEncoder passEncoder =
-      commandEncoder.BeginRenderPass(&m_shadowPassDescs[i]);
-    passEncoder.SetPipeline(m_ctx->pipeline.shadowRPL);
-    passEncoder.SetBindGroup(0, m_cascadeIndicesBG[i]);
-    passEncoder.SetBindGroup(1, m_state->sun.bindGroup);
-    passEncoder.SetBindGroup(2, m_blocksTextureBindGroup);
-    m_state->chunkManager.RenderShadowMap(passEncoder, 3, i);
-    passEncoder.End();
-  }
-  if (m_state->sun.ShouldRender()) {
-    for (size_t i = 1; i < Sun::numCascades; i++) {
-      RenderPassEncoder passEncoder =
-        commandEncoder.BeginRenderPass(&m_shadowPassDescs[i]);
-      passEncoder.SetPipeline(m_ctx->pipeline.shadowRPL);
-      passEncoder.SetBindGroup(0, m_cascadeIndicesBG[i]);
-      passEncoder.SetBindGroup(1, m_state->sun.bindGroup);
-      passEncoder.SetBindGroup(2, m_blocksTextureBindGroup);
-      m_state->chunkManager.RenderShadowMap(passEncoder, 3, i);
-      passEncoder.End();
-    }
+  m_gpuTimer.BeginFrame();
+  // wireframe draws stay on the cpu path, the args only hold triangle counts
+  m_gpuCulling = m_gpuCuller.enabled && !wireframe;
+  m_bundlesRecorded = 0;
+
+  if (m_state->player.camera.GetProjection() != m_gBufferProjection) {
+    WriteGBufferParams();
   }
-  // gbuffer pass
-  if (!wireframe) {
-    {
-      RenderPassEncoder passEncoder =
-        commandEncoder.BeginRenderPass(&m_gBufferPassDesc);
-      passEncoder.SetPipeline(m_ctx->pipeline.gBufferRPL);
-      passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-      passEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
-      m_state->chunkManager.Render(passEncoder, 2);
-      passEncoder.End();
-    }
+
+  // the kernel only rotates while accumulating, a still image stays still otherwise
+  bool temporal = ssaoTemporal && ssaoPath != SsaoPath::HalfRes && m_ssao.enabled;
+  if (temporal) {
+    m_ssaoFrame++;
   } else {
-    {
-      RenderPassEncoder passEncoder =
-        commandEncoder.BeginRenderPass(&m_gBufferDepthPassDesc);
-      passEncoder.SetPipeline(m_ctx->pipeline.gBufferDepthRPL);
-      passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-      passEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
-      m_state->chunkManager.Render(passEncoder, 2);
-      passEncoder.End();
-    }
-    {
-      RenderPassEncoder passEncoder =
-        commandEncoder.BeginRenderPass(&m_gBufferWirePassDesc);
-      passEncoder.SetPipeline(m_ctx->pipeline.gBufferWireRPL);
-      passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-      passEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
-      m_state->chunkManager.RenderWire(passEncoder, 2);
-      passEncoder.End();
-    }
-  }
-  // water pass
-  {
-    RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_waterPassDesc);
-    if (wireframe)
-      passEncoder.SetPipeline(m_ctx->pipeline.waterWireRPL);
-    else
-      passEncoder.SetPipeline(m_ctx->pipeline.waterRPL);
-    passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-    passEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
-    passEncoder.SetBindGroup(2, m_state->sun.bindGroup);
-    if (wireframe)
-      m_state->chunkManager.RenderWaterWire(passEncoder, 3);
-    else
-      m_state->chunkManager.RenderWater(passEncoder, 3);
-    passEncoder.End();
+    m_ssaoFrame = 0;
+    m_ssaoHistoryValid = false;
   }
-  // ssao pass
-  {
-    RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_ssaoPassDesc);
-    passEncoder.SetPipeline(m_ctx->pipeline.ssaoRPL);
-    passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-    passEncoder.SetBindGroup(1, m_gBufferBindGroup);
-    passEncoder.SetBindGroup(2, m_ssaoSamplingBindGroup);
-    passEncoder.SetVertexBuffer(0, m_quadBuffer);
-    passEncoder.Draw(6);
-    passEncoder.End();
+  if (m_ssao.frame != m_ssaoFrame % 64) {
+    m_ssao.frame = m_ssaoFrame % 64;
+    WRITE_SSAO_BUFFER(frame);
   }
-  // ssao-blur pass
-  {
-    RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_blurPassDesc);
-    passEncoder.SetPipeline(m_ctx->pipeline.blurRPL);
-    passEncoder.SetBindGroup(0, m_ssaoTextureBindGroups[0]);
-    passEncoder.SetVertexBuffer(0, m_quadBuffer);
-    passEncoder.Draw(6);
-    passEncoder.End();
+  m_ssaoHistory = m_ssaoFrame % 2;
+
+  m_graph.Execute(commandEncoder);
+
+  PROFILE_ZONE("Submit");
+  m_gpuTimer.Resolve(commandEncoder);
+  CommandBuffer command = commandEncoder.Finish();
+  m_ctx->queue.Submit(1, &command);
+
+  if (m_gpuCulling) m_gpuCuller.ReadBack();
+  m_gpuTimer.ReadBack();
+}
+
+// chunk passes replay render bundles, recorded again only when the key changes
+ChunkBundle::Key Renderer::BundleKey(size_t view, uint32_t variant) {
+  auto &chunkManager = m_state->chunkManager;
+  return ChunkBundle::Key{
+    .meshVersion = chunkManager.meshVersion,
+    .viewVersion = m_gpuCulling ? 0 : chunkManager.viewVersions[view],
+    .variant = variant << 1 | m_gpuCulling,
+  };
+}
+
+void Renderer::ShadowPass(const CommandEncoder &commandEncoder) {
+  auto &chunkManager = m_state->chunkManager;
+  auto renderShadowMap = [&](const RenderPassEncoder &passEncoder, size_t i) {
+    auto rect = m_shadowRects[i];
+    passEncoder.SetViewport(rect.x, rect.y, rect.z, rect.z, 0, 1);
+    passEncoder.SetScissorRect(rect.x, rect.y, rect.z, rect.z);
+    passEncoder.SetPipeline(m_ctx->pipeline.shadowClearRPL);
+    passEncoder.Draw(3);
+    util::frameStats.counters.DrawCalls("Shadow")++;
+    // viewport and scissor are pass state, the bundle keeps them
+    ExecuteChunkBundle(
+      "Shadow", passEncoder, m_shadowBundles[i],
+      BundleKey(1 + i, m_shadowSettings.depth16), {}, m_ctx->pipeline.shadowFormat,
+      [&](const RenderBundleEncoder &bundleEncoder) {
+        // both pipelines share a layout, the bind groups carry over
+        bundleEncoder.SetBindGroup(0, m_cascadeIndicesBG[i]);
+        bundleEncoder.SetBindGroup(1, m_state->sun.bindGroup);
+        bundleEncoder.SetBindGroup(2, m_blocksTextureBindGroup);
+        if (m_gpuCulling) {
+          // one draw per chunk, so every face goes through the alpha test
+          bundleEncoder.SetPipeline(m_ctx->pipeline.shadowAlphaRPL);
+          chunkManager.RenderDepthIndirect(
+            bundleEncoder, 3, m_gpuCuller.opaqueArgs[1 + i]
+          );
+        } else {
+          bundleEncoder.SetPipeline(m_ctx->pipeline.shadowRPL);
+          chunkManager.RenderShadowMap(bundleEncoder, 3, i, false);
+          bundleEncoder.SetPipeline(m_ctx->pipeline.shadowAlphaRPL);
+          chunkManager.RenderShadowMap(bundleEncoder, 3, i, true);
+        }
+      }
+    );
+  };
+  // cascades keep their last contents until their matrix or chunks change
+  m_shadowPasses = 0;
+  m_shadowDraws = 0;
+  RenderPassEncoder shadowPassEncoder;
+  for (int i = 0; i < m_state->sun.GetNumCascades(); i++) {
+    if (!m_state->sun.ShouldRender(i)) continue;
+    if (!shadowPassEncoder) {
+      m_shadowPassDesc.timestampWrites = m_gpuTimer.RenderPass("Shadow");
+      shadowPassEncoder = commandEncoder.BeginRenderPass(&m_shadowPassDesc);
+    }
+    renderShadowMap(shadowPassEncoder, i);
+    m_shadowPasses++;
+    m_shadowDraws += m_gpuCulling ? chunkManager.chunks.size()
+                                  : chunkManager.CulledCount(1 + i);
   }
-  // composite pass
-  {
-    RenderPassEncoder passEncoder =
-      commandEncoder.BeginRenderPass(&m_compositePassDesc);
-    passEncoder.SetPipeline(m_ctx->pipeline.compositeRPL);
+  if (shadowPassEncoder) shadowPassEncoder.End();
+}
+
+static std::initializer_list<TextureFormat> GBufferFormats(bool compact) {
+  static auto fullFormats = {
+    TextureFormat::RGBA16Float, TextureFormat::RGBA16Float, TextureFormat::BGRA8Unorm
+  };
+  static auto compactFormats = {TextureFormat::RGBA8Unorm, TextureFormat::BGRA8Unorm};
+  return compact ? compactFormats : fullFormats;
+}
+
+void Renderer::GBufferPass(const CommandEncoder &commandEncoder) {
+  auto &chunkManager = m_state->chunkManager;
+  auto &pipelines = m_ctx->pipeline;
+  m_gBufferPassDesc.timestampWrites = m_gpuTimer.RenderPass("G-Buffer");
+  RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_gBufferPassDesc);
+  ExecuteChunkBundle(
+    "G-Buffer", passEncoder, m_gBufferBundle, BundleKey(0, compactGBuffer),
+    GBufferFormats(compactGBuffer), m_ctx->depthFormat,
+    [&](const RenderBundleEncoder &bundleEncoder) {
+      bundleEncoder.SetPipeline(
+        compactGBuffer ? pipelines.gBufferCompactRPL : pipelines.gBufferRPL
+      );
+      bundleEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
+      bundleEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
+      if (m_gpuCulling) {
+        chunkManager.RenderIndirect(bundleEncoder, 2, m_gpuCuller.opaqueArgs[0]);
+      } else {
+        chunkManager.Render(bundleEncoder, 2);
+      }
+    }
+  );
+  if (m_farTerrain.enabled) {
+    passEncoder.SetPipeline(
+      compactGBuffer ? pipelines.farTerrainCompactRPL : pipelines.farTerrainRPL
+    );
     passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
-    passEncoder.SetBindGroup(1, m_gBufferBindGroup);
-    passEncoder.SetBindGroup(2, m_state->sun.bindGroup);
-    passEncoder.SetBindGroup(3, m_compositeBindGroup);
-    passEncoder.SetVertexBuffer(0, m_quadBuffer);
-    passEncoder.Draw(6);
-    ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), passEncoder.Get());
-    passEncoder.End();
+    size_t drawsBefore = util::frameStats.drawsEncoded;
+    m_farTerrain.Render(passEncoder);
+    util::frameStats.counters.DrawCalls("G-Buffer") +=
+      util::frameStats.drawsEncoded - drawsBefore;
   }
+  passEncoder.End();
+}
 
-  CommandBuffer command = commandEncoder.Finish();
-  m_ctx->queue.Submit(1, &command);
+void Renderer::GBufferWirePass(const CommandEncoder &commandEncoder) {
+  auto &pipelines = m_ctx->pipeline;
+  m_gBufferWirePassDesc.timestampWrites = m_gpuTimer.RenderPass("G-Buffer");
+  RenderPassEncoder passEncoder =
+    commandEncoder.BeginRenderPass(&m_gBufferWirePassDesc);
+  ExecuteChunkBundle(
+    "G-Buffer Wire", passEncoder, m_gBufferWireBundle, BundleKey(0, compactGBuffer),
+    GBufferFormats(compactGBuffer), m_ctx->depthFormat,
+    [&](const RenderBundleEncoder &bundleEncoder) {
+      bundleEncoder.SetPipeline(
+        compactGBuffer ? pipelines.gBufferWireCompactRPL : pipelines.gBufferWireRPL
+      );
+      bundleEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
+      bundleEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
+      m_state->chunkManager.RenderWire(bundleEncoder, 2);
+    }
+  );
+  passEncoder.End();
+}
+
+void Renderer::WaterPass(const CommandEncoder &commandEncoder) {
+  auto &chunkManager = m_state->chunkManager;
+  m_waterPassDesc.timestampWrites = m_gpuTimer.RenderPass("Water");
+  RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_waterPassDesc);
+  ExecuteChunkBundle(
+    "Water", passEncoder, m_waterBundle, BundleKey(0, wireframe),
+    {TextureFormat::BGRA8Unorm}, m_ctx->depthFormat,
+    [&](const RenderBundleEncoder &bundleEncoder) {
+      if (wireframe)
+        bundleEncoder.SetPipeline(m_ctx->pipeline.waterWireRPL);
+      else
+        bundleEncoder.SetPipeline(m_ctx->pipeline.waterRPL);
+      bundleEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
+      bundleEncoder.SetBindGroup(1, m_blocksTextureBindGroup);
+      bundleEncoder.SetBindGroup(2, m_state->sun.bindGroup);
+      if (wireframe)
+        chunkManager.RenderWaterWire(bundleEncoder, 3);
+      else if (m_gpuCulling)
+        chunkManager.RenderIndirect(bundleEncoder, 3, m_gpuCuller.waterArgs[0], true);
+      else
+        chunkManager.RenderWater(bundleEncoder, 3);
+    }
+  );
+  passEncoder.End();
+}
+
+void Renderer::QuadPass(
+  const CommandEncoder &commandEncoder, const char *name,
+  const util::RenderPassDescriptor &passDesc, const RenderPipeline &pipeline,
+  std::initializer_list<BindGroup> bindGroups
+) {
+  RenderPassDescriptor timedPassDesc = passDesc;
+  timedPassDesc.timestampWrites = m_gpuTimer.RenderPass(name);
+  RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&timedPassDesc);
+  passEncoder.SetPipeline(pipeline);
+  uint32_t groupIndex = 0;
+  for (auto &bindGroup : bindGroups) {
+    passEncoder.SetBindGroup(groupIndex++, bindGroup);
+  }
+  passEncoder.SetVertexBuffer(0, m_quadBuffer);
+  passEncoder.Draw(6);
+  passEncoder.End();
+  util::frameStats.counters.DrawCalls(name)++;
+}
+
+void Renderer::CompositePass(const CommandEncoder &commandEncoder) {
+  m_compositePassDesc.timestampWrites = m_gpuTimer.RenderPass("Composite");
+  RenderPassEncoder passEncoder = commandEncoder.BeginRenderPass(&m_compositePassDesc);
+  passEncoder.SetPipeline(m_ctx->pipeline.compositeRPL);
+  passEncoder.SetBindGroup(0, m_state->player.camera.bindGroup);
+  passEncoder.SetBindGroup(1, m_gBufferBindGroup);
+  passEncoder.SetBindGroup(2, m_state->sun.bindGroup);
+  passEncoder.SetBindGroup(3, m_compositeBindGroup);
+  passEncoder.SetVertexBuffer(0, m_quadBuffer);
+  passEncoder.Draw(6);
+  util::frameStats.counters.DrawCalls("Composite")++;
+  ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), passEncoder.Get());
+  passEncoder.End();
+}
+
+void Renderer::ExecuteChunkBundle(
+  const char *pass, const RenderPassEncoder &passEncoder, ChunkBundle &cache,
+  ChunkBundle::Key key, std::initializer_list<TextureFormat> colorFormats,
+  TextureFormat depthFormat,
+  const std::function<void(const RenderBundleEncoder &)> &record
+) {
+  if (!cache.bundle || !(cache.key == key)) {
+    std::vector<TextureFormat> formats(colorFormats);
+    RenderBundleEncoder bundleEncoder =
+      m_ctx->device.CreateRenderBundleEncoder(ToPtr(RenderBundleEncoderDescriptor{
+        .colorFormatCount = formats.size(),
+        .colorFormats = formats.data(),
+        .depthStencilFormat = depthFormat,
+      }));
+    size_t drawsBefore = util::frameStats.drawsEncoded;
+    record(bundleEncoder);
+    cache.draws = util::frameStats.drawsEncoded - drawsBefore;
+    cache.bundle = bundleEncoder.Finish();
+    cache.key = key;
+    m_bundlesRecorded++;
+  }
+  passEncoder.ExecuteBundles(1, &cache.bundle);
+  util::frameStats.counters.DrawCalls(pass) += cache.draws;
 }
 
 void Renderer::Present() {
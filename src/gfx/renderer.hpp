@@ -2,13 +2,23 @@
 
 #include <webgpu/webgpu_cpp.h>
 #include "dawn/utils/WGPUHelpers.h"
+#include "glm/ext/matrix_float4x4.hpp"
 #include "glm/ext/vector_float2.hpp"
+#include "glm/ext/vector_uint2.hpp"
+#include "glm/ext/vector_uint3.hpp"
 
 #include "gfx/context.hpp"
 #include "util/webgpu-util.hpp"
 #include "gfx/sun.hpp"
+#include "gfx/gpu_culler.hpp"
+#include "gfx/gpu_timer.hpp"
+#include "gfx/render_graph.hpp"
+#include "game/far_terrain.hpp"
 
 #include <array>
+#include <functional>
+#include <initializer_list>
+#include <string>
 
 // forward declaration
 struct GameState;
@@ -25,6 +35,7 @@ struct SSAO {
   int sampleSize;
   float radius;
   float bias;
+  uint32_t frame = 0; // rotates the kernel, see Renderer::ssaoTemporal
 
   SSAO() {
     SetDefault();
@@ -37,30 +48,117 @@ struct SSAO {
   }
 };
 #define WRITE_SSAO_BUFFER(field)                                                       \
-  m_ctx->queue.WriteBuffer(                                                            \
-    m_ssaoBuffer, offsetof(SSAO, field), &m_ssao.field, sizeof(SSAO::field)            \
+  util::WriteBuffer(                                                                   \
+    m_ctx->queue, m_ssaoBuffer, offsetof(SSAO, field), &m_ssao.field,                  \
+    sizeof(SSAO::field)                                                                \
   )
 
+// how ssao and its blur are computed, all end in the texture composite reads
+enum class SsaoPath {
+  Fragment,
+  HalfRes, // fragment passes on a downsampled gbuffer, upsampled after
+  // workgroup memory tiles, separable depth-aware blur. the radius is capped to
+  // the tile's apron in pixels
+  Compute,
+};
+
+// gbuffer bind group binding 4, tells readers which layout the textures hold
+struct GBufferParams {
+  glm::mat4 inverseProjection; // rebuilds compact positions from depth
+  uint32_t compact;
+  uint32_t padding[3];
+};
+
+// layout of the shadow atlas, applied with Renderer::CreateShadowAtlas
+struct ShadowSettings {
+  int numCascades = Sun::maxCascades;
+  static constexpr int minResolution = 512; // the smallest the options offer
+  // side of each cascade's square map, powers of two
+  std::array<int, Sun::maxCascades> resolutions = {4096, 4096, 4096, 2048, 2048};
+  bool depth16 = false; // Depth16Unorm instead of Depth32Float
+};
+
+// chunk draw list recorded once and replayed with ExecuteBundles
+struct ChunkBundle {
+  struct Key {
+    uint64_t meshVersion;
+    uint64_t viewVersion;
+    uint32_t variant; // pipeline and draw path
+    bool operator==(const Key &) const = default;
+  };
+  Key key;
+  wgpu::RenderBundle bundle;
+  size_t draws = 0; // recorded into the bundle
+};
+
 class Renderer {
 private:
+  // changing these rebuilds the render graph, see BuildGraph
   bool wireframe = false;
+  SsaoPath ssaoPath = SsaoPath::Fragment;
+  // blend each frame's ao into a reprojected history, full resolution paths only
+  bool ssaoTemporal = false;
+  // packed normals and positions rebuilt from depth, instead of two RGBA16Float
+  // targets. off until the two are compared with the gpu timer
+  bool compactGBuffer = false;
 
   gfx::Context *m_ctx;
   GameState *m_state;
 
   wgpu::BindGroup m_blocksTextureBindGroup;
   wgpu::Buffer m_quadBuffer;
-
-  // shadow
-  // util::RenderPassDescriptor m_shadowPassDesc;
-  std::array<util::RenderPassDescriptor, Sun::numCascades> m_shadowPassDescs;
-  std::array<wgpu::BindGroup, Sun::numCascades> m_cascadeIndicesBG;
-
-  // gbuffer
-  // position (view-space), normal, color
+  wgpu::Sampler m_nearestClampSampler;
+
+  GpuCuller m_gpuCuller;
+  GpuTimer m_gpuTimer;
+  game::FarTerrain m_farTerrain;
+
+  // every pass of the frame. textures that don't outlive the frame are the graph's,
+  // and so is everything referring to them: pass descriptors and bind groups below
+  // are created by the passes' setup, and stay null while a pass is culled
+  RenderGraph m_graph;
+  bool m_graphDirty = true;
+  void BuildGraph();
+
+  // per frame state the passes read
+  bool m_gpuCulling = false; // wireframe draws stay on the cpu path
+  size_t m_ssaoHistory = 0; // history texture written this frame
+
+  // chunk draws of each pass, see ExecuteChunkBundle
+  std::array<ChunkBundle, Sun::maxCascades> m_shadowBundles;
+  ChunkBundle m_gBufferBundle;
+  ChunkBundle m_gBufferDepthBundle;
+  ChunkBundle m_gBufferWireBundle;
+  ChunkBundle m_waterBundle;
+  size_t m_bundlesRecorded = 0; // this frame
+  size_t m_shadowPasses = 0; // cascades redrawn this frame
+  size_t m_shadowDraws = 0; // chunk draws in those cascades
+
+  // shadow, every cascade renders into its own square of one atlas
+  ShadowSettings m_shadowSettings;
+  wgpu::Texture m_shadowAtlas;
+  glm::uvec2 m_shadowAtlasSize;
+  std::array<glm::uvec3, Sun::maxCascades> m_shadowRects; // corner, size (texels)
+  wgpu::Buffer m_shadowRectsBuffer;
+  wgpu::Sampler m_shadowSampler;
+  util::RenderPassDescriptor m_shadowPassDesc;
+  std::array<wgpu::BindGroup, Sun::maxCascades> m_cascadeIndicesBG;
+  wgpu::TextureView m_shadowAtlasView;
+  // also rebuilds the graph, composite samples the atlas
+  void CreateShadowAtlas();
+
+  // gbuffer, see compactGBuffer for the layouts
+  // full: position (view-space), normal, color
+  // compact: octahedral normal and surface flag, color. position is read from a
+  // copy of the depth buffer, since water draws into the depth buffer after
+  wgpu::Texture m_depthTexture; // hi-z is built from it outside the graph
   dawn::utils::ComboRenderPassDescriptor m_gBufferPassDesc;
   dawn::utils::ComboRenderPassDescriptor m_gBufferWirePassDesc;
   dawn::utils::ComboRenderPassDescriptor m_gBufferDepthPassDesc;
+  std::array<wgpu::Buffer, 2> m_gBufferParamsBuffers; // full, compact
+  // the camera projection the params were written with
+  glm::mat4 m_gBufferProjection;
+  void WriteGBufferParams();
 
   // water
   dawn::utils::ComboRenderPassDescriptor m_waterPassDesc;
@@ -68,20 +166,70 @@ private:
   // ssao
   SSAO m_ssao;
   wgpu::Buffer m_ssaoBuffer;
+  wgpu::Texture m_whiteTexture; // composite's ao while ssao is off
 
   wgpu::BindGroup m_gBufferBindGroup;
   wgpu::BindGroup m_ssaoSamplingBindGroup;
   util::RenderPassDescriptor m_ssaoPassDesc;
 
   // blur
-  // pre-blur and blurred (used in composite)
-  std::array<wgpu::BindGroup, 2> m_ssaoTextureBindGroups;
+  wgpu::BindGroup m_ssaoTextureBindGroup; // pre-blur
   util::RenderPassDescriptor m_blurPassDesc;
 
+  // compute ssao, blurred along rows into a second texture and back along columns
+  wgpu::BindGroup m_ssaoOutputBindGroup;
+  std::array<wgpu::BindGroup, 2> m_ssaoBlurBindGroups; // horizontal, vertical
+
+  // temporal ssao, history is (ao, view depth, frames accumulated) and ping pongs
+  // between two textures by frame parity
+  uint32_t m_ssaoFrame = 0;
+  bool m_ssaoHistoryValid = false; // written last frame
+  std::array<wgpu::Texture, 2> m_ssaoHistoryTextures;
+  std::array<util::RenderPassDescriptor, 2> m_ssaoHistoryPassDescs;
+  // [compute path][history written], reads the path's raw ao and the other history
+  std::array<std::array<wgpu::BindGroup, 2>, 2> m_ssaoTemporalBindGroups;
+  // blur input for each history, for the fragment and compute blurs
+  std::array<wgpu::BindGroup, 2> m_ssaoHistoryBlurBindGroups;
+  std::array<wgpu::BindGroup, 2> m_ssaoHistoryComputeBlurBindGroups;
+
+  // half resolution ssao: the gbuffer is downsampled, ssao and blur run on that,
+  // and the result is upsampled to full resolution for composite
+  util::RenderPassDescriptor m_ssaoDownsamplePassDesc;
+  wgpu::BindGroup m_halfGBufferBindGroup;
+  util::RenderPassDescriptor m_ssaoHalfPassDesc;
+  wgpu::BindGroup m_ssaoHalfTextureBindGroup; // pre-blur
+  util::RenderPassDescriptor m_blurHalfPassDesc;
+  wgpu::BindGroup m_ssaoUpsampleBindGroup;
+  util::RenderPassDescriptor m_ssaoUpsamplePassDesc;
+
   // composite
   wgpu::BindGroup m_compositeBindGroup;
   wgpu::RenderPassDescriptor m_compositePassDesc;
 
+  // pass bodies, see BuildGraph
+  void ShadowPass(const wgpu::CommandEncoder &commandEncoder);
+  void GBufferPass(const wgpu::CommandEncoder &commandEncoder);
+  void GBufferWirePass(const wgpu::CommandEncoder &commandEncoder);
+  void WaterPass(const wgpu::CommandEncoder &commandEncoder);
+  void CompositePass(const wgpu::CommandEncoder &commandEncoder);
+  // fullscreen quad, timed and counted under name (a literal)
+  void QuadPass(
+    const wgpu::CommandEncoder &commandEncoder, const char *name,
+    const util::RenderPassDescriptor &passDesc, const wgpu::RenderPipeline &pipeline,
+    std::initializer_list<wgpu::BindGroup> bindGroups
+  );
+
+  // with gpu culling every loaded chunk is drawn, so the cpu visible set is ignored
+  ChunkBundle::Key BundleKey(size_t view, uint32_t variant);
+  // replays the cached bundle, records it first if the key changed. its draws count
+  // toward pass in FrameStats
+  void ExecuteChunkBundle(
+    const char *pass, const wgpu::RenderPassEncoder &passEncoder, ChunkBundle &cache,
+    ChunkBundle::Key key, std::initializer_list<wgpu::TextureFormat> colorFormats,
+    wgpu::TextureFormat depthFormat,
+    const std::function<void(const wgpu::RenderBundleEncoder &)> &record
+  );
+
 public:
   Renderer(gfx::Context *ctx, GameState *state);
   void ImguiRender();
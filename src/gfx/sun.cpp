@@ -6,146 +6,167 @@
 #include "glm/ext/matrix_transform.hpp"
 #include "glm/ext/vector_float2.hpp"
 #include "glm/gtx/transform.hpp"
+#include "glm/geometric.hpp"
+#include "glm/trigonometric.hpp"
 
 #include "game.hpp"
+#include "util/profiler.hpp"
 #include "util/webgpu-util.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace gfx {
 
 Sun::Sun(gfx::Context *ctx, GameState *state, glm::vec2 riseTurn)
     : m_ctx(ctx), m_state(state), riseTurn(riseTurn) {
-  UpdateDirAndProj();
+  UpdateDir();
+  m_viewProjs.fill(glm::mat4(1)); // until each cascade's first refresh
   m_sunDirBuffer = util::CreateUniformBuffer(m_ctx->device, sizeof(glm::vec3), &dir);
 
-  // glm::vec2 depth_range(1, 1024);
-  // auto halfLength = areaLength / 2;
-  // for (int i = numCascades - 1; i >= 0; i--) {
-  //   m_projs[i] = glm::ortho<float>(
-  //     -halfLength, halfLength, -halfLength, halfLength, depth_range.x, depth_range.y
-  //   );
-  //   halfLength /= 2;
-  // }
-
   m_sunViewProjsBuffer =
-    util::CreateStorageBuffer(m_ctx->device, sizeof(glm::mat4) * numCascades);
+    util::CreateStorageBuffer(m_ctx->device, sizeof(glm::mat4) * maxCascades);
 
-  auto numCascadesBuffer =
-    util::CreateUniformBuffer(m_ctx->device, sizeof(numCascades), &numCascades);
+  m_numCascadesBuffer = util::CreateUniformBuffer(
+    m_ctx->device, sizeof(m_numCascades), &m_numCascades
+  );
 
   bindGroup = dawn::utils::MakeBindGroup(
     ctx->device, ctx->pipeline.sunBGL,
     {
       {0, m_sunDirBuffer},
       {1, m_sunViewProjsBuffer},
-      {2, numCascadesBuffer},
+      {2, m_numCascadesBuffer},
     }
   );
 
   InvokeUpdate();
 }
 
-glm::mat4 Sun::GetView() {
-  const float distance = 512;
-
-  // get current block height at play pos
-  auto centerPos = m_state->player.GetPosition();
-  auto pos = centerPos;
-  pos.z = 0;
-  auto [currChunk, localPos] = *(m_state->chunkManager.GetChunkAndPos(pos));
-  for (int i = game::Chunk::SIZE.z - 1; i >= 0; i--) {
-    auto pos = localPos;
-    pos.z = i;
-    auto blockId = currChunk->GetBlock(pos);
-    if (blockId != game::BlockId::Air) {
-      centerPos.z = i + 1;
-      break;
-    }
-  }
-  auto eyePos = centerPos + dir * distance;
-
-  auto view = glm::lookAt(eyePos, centerPos, up);
-  return view;
-}
-
-void Sun::UpdateDirAndProj() {
+void Sun::UpdateDir() {
   auto riseMat = glm::rotate(glm::radians(-riseTurn.x), glm::vec3(0, 1, 0));
   auto turnMat = glm::rotate(glm::radians(riseTurn.y), glm::vec3(0, 0, 1));
   auto transformMat = turnMat * riseMat;
   dir = transformMat * glm::vec4(1, 0, 0, 1);
   up = transformMat * glm::vec4(0, 0, 1, 1);
+}
 
-  auto angle = glm::radians(90 - riseTurn.x);
-  auto scale = glm::cos(angle);
-  scale = glm::pow(scale, 0.4);  // tone down the scaling a bit
-
-  glm::vec2 depth_range(1, 1024);
-  auto halfLength = areaLength / 2;
-  for (int i = numCascades - 1; i >= 0; i--) {
-    auto vertHalfLength = halfLength * scale;
-    m_projs[i] = glm::ortho<float>(
-      -halfLength, halfLength, -vertHalfLength, vertHalfLength, depth_range.x, depth_range.y
-    );
-    halfLength /= 2;
-  }
+// the smallest sphere around the slice's corners. it sits on the view axis and its
+// radius only depends on the projection, so turning the camera doesn't resize it
+Sun::Fit Sun::FitCascade(int cascadeLevel) {
+  auto &camera = m_state->player.camera;
+  float near = cascadeLevel == 0 ? camera.near : splits[cascadeLevel - 1];
+  float far = splits[cascadeLevel];
+
+  // squared spread of the corners per unit of depth
+  float tanHalfY = glm::tan(camera.fov / 2);
+  float tanHalfX = tanHalfY * camera.aspect;
+  float k = tanHalfX * tanHalfX + tanHalfY * tanHalfY;
+
+  float centerDist = std::min((near + far) * (1 + k) / 2, far);
+  float radius = std::sqrt(std::max(
+    (centerDist - near) * (centerDist - near) + near * near * k,
+    (far - centerDist) * (far - centerDist) + far * far * k
+  ));
+  return Fit{camera.position + camera.direction * centerDist, radius};
+}
+
+void Sun::Refresh(int i, const Fit &fit) {
+  m_fits[i] = fit;
+  float radius = fit.radius * (1 + slack);
+
+  // snap the center to whole texels across the sun's view, so the map only ever
+  // moves by whole texels and edges don't shimmer
+  glm::mat4 lightRotation = glm::lookAt(glm::vec3(0), -dir, up);
+  glm::vec3 lightCenter = lightRotation * glm::vec4(fit.center, 1);
+  float texelSize = 2 * radius / resolutions[i];
+  lightCenter.x = glm::floor(lightCenter.x / texelSize) * texelSize;
+  lightCenter.y = glm::floor(lightCenter.y / texelSize) * texelSize;
+  glm::vec3 center = glm::inverse(lightRotation) * glm::vec4(lightCenter, 1);
+
+  auto view = glm::lookAt(center + dir * casterDistance, center, up);
+  auto proj =
+    glm::ortho(-radius, radius, -radius, radius, 0.0f, casterDistance + radius);
+  m_viewProjs[i] = proj * view;
+
+  auto stride = sizeof(glm::mat4);
+  util::WriteBuffer(
+    m_ctx->queue, m_sunViewProjsBuffer, stride * i, &m_viewProjs[i], stride
+  );
+  m_cascadeStale[i] = false;
+  m_cascadeRender[i] = true;
+}
+
+void Sun::SetNumCascades(int numCascades) {
+  numCascades = std::clamp(numCascades, 1, maxCascades);
+  if (numCascades == m_numCascades) return;
+  m_numCascades = numCascades;
+  m_nextCascade = 1;
+  util::WriteBuffer(
+    m_ctx->queue, m_numCascadesBuffer, 0, &m_numCascades, sizeof(m_numCascades)
+  );
+  InvokeUpdate();
 }
 
 void Sun::InvokeUpdate() {
-  shouldUpdate = true;
-  shouldUpdateFirst = true;
+  m_cascadeStale.fill(true);
+  m_dirChanged = true;
 }
 
-bool Sun::ShouldRender() {
-  if (shouldRender) {
-    shouldRender = false;
-    return true;
+void Sun::InvalidateShadows() {
+  m_cascadeRender.fill(true);
+}
+
+void Sun::MarkChanged(const util::AABB &bounds) {
+  for (int i = 0; i < m_numCascades; i++) {
+    if (GetFrustum(i).Intersects(bounds)) m_cascadeRender[i] = true;
   }
-  return false;
 }
 
-bool Sun::ShouldRenderFirst() {
-  if (shouldRenderFirst) {
-    shouldRenderFirst = false;
+bool Sun::ShouldRender(int cascadeLevel) {
+  if (m_cascadeRender[cascadeLevel]) {
+    m_cascadeRender[cascadeLevel] = false;
     return true;
   }
   return false;
 }
 
 void Sun::Update() {
-  timeSinceUpdate += m_state->dt;
-
-  bool shouldUpdateRest = timeSinceUpdate > minTime && shouldUpdate;
-  if (shouldUpdateFirst || shouldUpdateRest) {
-    UpdateDirAndProj();
-    m_ctx->queue.WriteBuffer(m_sunDirBuffer, 0, &dir, sizeof(dir));
-    auto view = GetView();
-
-    if (shouldUpdateFirst) {
-      int i = 0;
-      m_viewProjs[i] = m_projs[i] * view;
-      auto stride = sizeof(glm::mat4);
-      m_ctx->queue.WriteBuffer(
-        m_sunViewProjsBuffer, stride * i, &m_viewProjs[i], stride
-      );
-
-      shouldUpdateFirst = false;
-      shouldRenderFirst = true;
-    }
+  PROFILE_ZONE("Sun::Update");
+  bool dirChanged = m_dirChanged;
+  if (m_dirChanged) {
+    UpdateDir();
+    util::WriteBuffer(m_ctx->queue, m_sunDirBuffer, 0, &dir, sizeof(dir));
+    m_dirChanged = false;
+  }
 
-    if (shouldUpdateRest) {
-      for (size_t i = 1; i < numCascades; i++) {
-        m_viewProjs[i] = m_projs[i] * view;
-        auto stride = sizeof(glm::mat4);
-        m_ctx->queue.WriteBuffer(
-          m_sunViewProjsBuffer, stride * i, &m_viewProjs[i], stride
-        );
-      }
-
-      timeSinceUpdate = 0;
-      shouldUpdate = false;
-      shouldRender = true;
+  std::array<Fit, maxCascades> fits;
+  for (int i = 0; i < m_numCascades; i++) {
+    fits[i] = FitCascade(i);
+    auto &last = m_fits[i];
+    if (glm::distance(fits[i].center, last.center) > last.radius * slack ||
+        fits[i].radius != last.radius) {
+      m_cascadeStale[i] = true;
     }
   }
+
+  // the first cascade covers the player's surroundings, it can't lag behind
+  if (m_cascadeStale[0]) Refresh(0, fits[0]);
+  // cascades of different suns don't line up, and the lookups would show the seams
+  if (dirChanged) {
+    for (int i = 1; i < m_numCascades; i++) Refresh(i, fits[i]);
+    return;
+  }
+  // the larger ones are expensive and change little per refresh, spread them out.
+  // until then the slice may poke out of them, and lookups fall to the next one
+  int refreshed = 0;
+  for (int n = 1; n < m_numCascades && refreshed < cascadesPerFrame; n++) {
+    int i = m_nextCascade;
+    m_nextCascade = m_nextCascade % (m_numCascades - 1) + 1;
+    if (!m_cascadeStale[i]) continue;
+    Refresh(i, fits[i]);
+    refreshed++;
+  }
 }
 
 util::Frustum Sun::GetFrustum(int cascadeLevel) {
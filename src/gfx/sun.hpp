@@ -12,50 +12,82 @@ namespace gfx {
 
 class Sun {
 public:
-  static constexpr int numCascades = 5;
+  // storage is sized for this many, numCascades of them are in use
+  static constexpr int maxCascades = 5;
 
 private:
   gfx::Context *m_ctx;
   GameState *m_state;
 
-  std::array<glm::mat4, numCascades> m_projs;
-  std::array<glm::mat4, numCascades> m_viewProjs;
+  std::array<glm::mat4, maxCascades> m_viewProjs;
+
+  // bounding sphere of a cascade's slice of the camera frustum
+  struct Fit {
+    glm::vec3 center;
+    float radius;
+  };
+  std::array<Fit, maxCascades> m_fits{}; // as of each cascade's last refresh
+  Fit FitCascade(int cascadeLevel);
+  void Refresh(int cascadeLevel, const Fit &fit);
 
   wgpu::Buffer m_sunDirBuffer;
   wgpu::Buffer m_sunViewProjsBuffer;
+  wgpu::Buffer m_numCascadesBuffer;
+  int m_numCascades = maxCascades;
 
-  bool shouldRender;
-  bool shouldUpdate;
-
-  bool shouldRenderFirst;
-  bool shouldUpdateFirst;
-
-  static constexpr float minTime = 0.3;  // time for shadow maps to update
+  // matrix is out of date, the first cascade is refreshed right away and the rest
+  // round robin, see cascadesPerFrame. all of them at once when the sun moves
+  std::array<bool, maxCascades> m_cascadeStale{};
+  // matrix or the chunks inside changed, cleared once the renderer redraws it
+  std::array<bool, maxCascades> m_cascadeRender{};
+  int m_nextCascade = 1;
+  bool m_dirChanged = true;
 
   // these two are calculated from riseTurn
   glm::vec3 dir;  // direction is ground to sun
   glm::vec3 up;
 
-  glm::mat4 GetView();
-  void UpdateDirAndProj();
+  void UpdateDir();
 
 public:
-  // distance player has to travel for shadow map and chunks to update
+  // distance player has to travel for chunks to update
   static constexpr int updateDist = 10;
-  static constexpr float areaLength = 16 * 40;
+  // cascades are padded by this much of their radius, and only follow the camera
+  // once its slice has drifted that far, so small moves don't redraw them
+  static constexpr float slack = 0.1;
+  // how far behind a cascade's slice blocks can still cast into it
+  static constexpr float casterDistance = 512;
+
+  // far end of each cascade's slice of the camera frustum (blocks), the first
+  // starts at the near plane
+  std::array<float, maxCascades> splits = {32, 80, 160, 320, 560};
+  // side of each cascade's map, for snapping to texels. set with the atlas
+  std::array<int, maxCascades> resolutions = {4096, 4096, 4096, 4096, 4096};
 
   glm::vec2 riseTurn;  // rise and turn of sun angle
 
   wgpu::BindGroup bindGroup;
 
-  float timeSinceUpdate = 1;
+  // stale cascades past the first that get a new matrix each frame
+  int cascadesPerFrame = 1;
 
   Sun() = default;
   Sun(gfx::Context *ctx, GameState *state, glm::vec2 riseTurn);
 
+  int GetNumCascades() {
+    return m_numCascades;
+  }
+  // the camera frustum is covered up to splits[numCascades - 1]
+  void SetNumCascades(int numCascades);
+
+  // the sun, splits or resolutions changed, every cascade needs a new matrix
   void InvokeUpdate();
-  bool ShouldRender();
-  bool ShouldRenderFirst();
+  // the shadow maps were lost, redraws every cascade as is
+  void InvalidateShadows();
+  // chunk geometry inside bounds changed, redraws the cascades it's in
+  void MarkChanged(const util::AABB &bounds);
+  // true once per change, the cascade is considered drawn after
+  bool ShouldRender(int cascadeLevel);
 
   void Update();
   glm::vec3 GetDir() {
@@ -16,7 +16,8 @@ Camera::Camera(
   float near,
   float far
 )
-    : m_ctx(ctx), position(position), orientation(orientation), fov(fov) {
+    : m_ctx(ctx), position(position), orientation(orientation), fov(fov),
+      aspect(aspect), near(near) {
   m_projection = glm::perspective(fov, aspect, near, far);
 
   // create bind group
@@ -24,6 +25,7 @@ Camera::Camera(
   m_viewBuffer = util::CreateUniformBuffer(m_ctx->device, size);
   m_projectionBuffer = util::CreateUniformBuffer(m_ctx->device, size, &m_projection);
   m_inverseViewBuffer = util::CreateUniformBuffer(m_ctx->device, size);
+  m_prevViewBuffer = util::CreateUniformBuffer(m_ctx->device, size);
 
   bindGroup = dawn::utils::MakeBindGroup(
     ctx->device, ctx->pipeline.cameraBGL,
@@ -31,10 +33,14 @@ Camera::Camera(
       {0, m_viewBuffer},
       {1, m_projectionBuffer},
       {2, m_inverseViewBuffer},
+      {3, m_prevViewBuffer},
     }
   );
 
   Update();
+  // no previous frame yet
+  m_prevView = m_view;
+  WriteBuffer(m_ctx->queue, m_prevViewBuffer, 0, &m_prevView, sizeof(m_prevView));
 }
 
 void Camera::Update() {
@@ -44,11 +50,15 @@ void Camera::Update() {
   glm::mat4 rotation = yaw * pitch * roll;
 
   direction = rotation * forward;
+  m_prevView = m_view;
   m_view = glm::lookAt(position, position + direction, up);
   glm::mat4 inverseView = glm::inverse(m_view);
 
-  m_ctx->queue.WriteBuffer(m_viewBuffer, 0, &m_view, sizeof(m_view));
-  m_ctx->queue.WriteBuffer(m_inverseViewBuffer, 0, &inverseView, sizeof(inverseView));
+  WriteBuffer(m_ctx->queue, m_viewBuffer, 0, &m_view, sizeof(m_view));
+  WriteBuffer(m_ctx->queue, m_prevViewBuffer, 0, &m_prevView, sizeof(m_prevView));
+  WriteBuffer(
+    m_ctx->queue, m_inverseViewBuffer, 0, &inverseView, sizeof(inverseView)
+  );
 }
 
 } // namespace util
@@ -10,10 +10,12 @@ class Camera {
 private:
   gfx::Context *m_ctx;
   glm::mat4 m_view;
+  glm::mat4 m_prevView; // as of the previous Update, for reprojection
   glm::mat4 m_projection;
   wgpu::Buffer m_viewBuffer;
   wgpu::Buffer m_projectionBuffer;
   wgpu::Buffer m_inverseViewBuffer;
+  wgpu::Buffer m_prevViewBuffer;
 
 public:
   constexpr static auto forward = glm::vec4(1.0, 0.0, 0.0, 1.0);
@@ -23,6 +25,8 @@ public:
   glm::vec3 direction;
   glm::vec3 orientation; // pitch, roll, yaw
   float fov;
+  float aspect;
+  float near;
 
   Camera() = default;
   Camera(
@@ -34,10 +38,23 @@ public:
     float near,
     float far
   );
+  // once per frame, the previous frame's view is kept
   void Update();
   Frustum GetFrustum() {
     return Frustum(m_projection * m_view);
   }
+  glm::mat4 GetProjection() {
+    return m_projection;
+  }
+  glm::mat4 GetViewProj() {
+    return m_projection * m_view;
+  }
+  glm::mat4 GetPrevView() {
+    return m_prevView;
+  }
+  glm::mat4 GetPrevViewProj() {
+    return m_projection * m_prevView;
+  }
 };
 
 } // namespace util
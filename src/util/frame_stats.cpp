@@ -0,0 +1,121 @@
+#include "frame_stats.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+namespace util {
+
+FrameStats frameStats;
+
+size_t &FrameStats::Counters::DrawCalls(const char *pass) {
+  for (size_t i = 0; i < numPasses; i++) {
+    if (drawCalls[i].pass == pass) return drawCalls[i].draws;
+  }
+  // the same name can come from another literal
+  for (size_t i = 0; i < numPasses; i++) {
+    if (std::strcmp(drawCalls[i].pass, pass) == 0) return drawCalls[i].draws;
+  }
+  assert(numPasses < maxPasses);
+  drawCalls[numPasses] = {pass, 0};
+  return drawCalls[numPasses++].draws;
+}
+
+void FrameStats::EndFrame(float dt) {
+  if (dt != 0) {
+    m_frameTimes[m_frames % windowSize] = dt * 1000;
+    m_frames++;
+
+    // nth_element on a copy, the ring stays in frame order for the histogram
+    size_t count = std::min(m_frames, windowSize);
+    std::array<float, windowSize> sorted = m_frameTimes;
+    auto percentile = [&](float p) {
+      auto nth = sorted.begin() + std::min(size_t(p * count), count - 1);
+      std::nth_element(sorted.begin(), nth, sorted.begin() + count);
+      return *nth;
+    };
+    m_percentiles = {
+      .p50 = percentile(0.5),
+      .p95 = percentile(0.95),
+      .p99 = percentile(0.99),
+      .max = *std::max_element(sorted.begin(), sorted.begin() + count),
+    };
+  }
+
+  if (Logging()) {
+    m_logCounters.chunksGenerated += counters.chunksGenerated;
+    m_logCounters.chunksMeshed += counters.chunksMeshed;
+    m_logCounters.facesEmitted += counters.facesEmitted;
+    m_logCounters.bytesUploaded += counters.bytesUploaded;
+    m_logCounters.drawCalls = counters.drawCalls;
+    m_logCounters.numPasses = counters.numPasses;
+    m_logCounters.visibleChunks = counters.visibleChunks;
+    m_logFrames++;
+    m_sinceLog += dt;
+    if (m_sinceLog >= m_logInterval) WriteLogLine();
+  }
+
+  // passes keep their slot, a pass that didn't run shows 0
+  last = counters;
+  counters.chunksGenerated = 0;
+  counters.chunksMeshed = 0;
+  counters.facesEmitted = 0;
+  counters.bytesUploaded = 0;
+  for (size_t i = 0; i < counters.numPasses; i++) counters.drawCalls[i].draws = 0;
+  counters.visibleChunks.fill(0);
+}
+
+float FrameStats::GetFps() const {
+  size_t count = std::min(m_frames, windowSize);
+  if (count == 0) return 0;
+  float total = std::reduce(m_frameTimes.begin(), m_frameTimes.begin() + count);
+  return count * 1000 / total;
+}
+
+void FrameStats::StartLog(const std::string &path, float interval) {
+  m_log.open(path, std::ios::app);
+  if (!m_log) {
+    std::cerr << "Cannot write " << path << std::endl;
+    return;
+  }
+  m_logInterval = interval;
+  m_sinceLog = 0;
+  m_logCounters = {};
+  m_logFrames = 0;
+}
+
+void FrameStats::StopLog() {
+  m_log.close();
+}
+
+void FrameStats::WriteLogLine() {
+  auto &c = m_logCounters;
+  m_log << "{\"frame\": " << m_frames << ", \"frames\": " << m_logFrames
+        << ", \"seconds\": " << m_sinceLog << ", \"fps\": " << GetFps()
+        << ", \"p50\": " << m_percentiles.p50 << ", \"p95\": " << m_percentiles.p95
+        << ", \"p99\": " << m_percentiles.p99 << ", \"max\": " << m_percentiles.max
+        << ", \"chunksGenerated\": " << c.chunksGenerated
+        << ", \"chunksMeshed\": " << c.chunksMeshed
+        << ", \"facesEmitted\": " << c.facesEmitted
+        << ", \"bytesUploaded\": " << c.bytesUploaded << ", \"drawCalls\": {";
+  const char *separator = "";
+  for (auto &[pass, draws] : c.Passes()) {
+    m_log << separator << "\"" << pass << "\": " << draws;
+    separator = ", ";
+  }
+  m_log << "}, \"visibleChunks\": [";
+  separator = "";
+  for (size_t visible : c.visibleChunks) {
+    m_log << separator << visible;
+    separator = ", ";
+  }
+  // flushed so a dashboard tailing the file sees whole lines
+  m_log << "]}" << std::endl;
+
+  m_sinceLog = 0;
+  m_logCounters = {};
+  m_logFrames = 0;
+}
+
+} // namespace util
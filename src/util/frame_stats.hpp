@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <fstream>
+#include <span>
+#include <string>
+
+namespace util {
+
+// frame time percentiles over a fixed window of frames, and counters that the
+// subsystems add to during a frame. optionally appended to a file as json lines
+class FrameStats {
+public:
+  static constexpr size_t windowSize = 256; // frames
+  static constexpr size_t maxViews = 8; // camera, then each cascade
+  static constexpr size_t maxPasses = 32;
+
+  struct PassDraws {
+    const char *pass; // must outlive the stats, a literal or interned
+    size_t draws;
+  };
+
+  struct Counters {
+    size_t chunksGenerated = 0;
+    size_t chunksMeshed = 0;
+    size_t facesEmitted = 0;
+    size_t bytesUploaded = 0; // buffer and texture writes
+    // per pass, in the order they first drew
+    std::array<PassDraws, maxPasses> drawCalls{};
+    size_t numPasses = 0;
+    std::array<size_t, maxViews> visibleChunks{};
+
+    // the pass's draw count, added the first time. found by pointer, the names are
+    // only compared for a pointer not seen before
+    size_t &DrawCalls(const char *pass);
+    std::span<const PassDraws> Passes() const {
+      return {drawCalls.data(), numPasses};
+    }
+  };
+
+  struct Percentiles {
+    float p50, p95, p99, max; // ms
+  };
+
+private:
+  std::array<float, windowSize> m_frameTimes{}; // ms, a ring
+  size_t m_frames = 0; // ever ended
+  Percentiles m_percentiles{};
+
+  std::ofstream m_log;
+  float m_logInterval = 1; // seconds
+  float m_sinceLog = 0;
+  // summed since the last line, the draw calls and visible chunks are the last
+  // frame's instead
+  Counters m_logCounters;
+  size_t m_logFrames = 0;
+
+  void WriteLogLine();
+
+public:
+  // the frame being counted
+  Counters counters;
+  // the last ended frame
+  Counters last;
+  // every draw encoded so far, never reset. render bundles take their draw counts
+  // from it while recording
+  size_t drawsEncoded = 0;
+
+  // dt is the frame's length in seconds, the counters move to last and restart
+  void EndFrame(float dt);
+  float GetFps() const;
+  const Percentiles &GetPercentiles() const {
+    return m_percentiles;
+  }
+  // oldest first from GetFrameOffset, for ImGui::PlotHistogram
+  const float *GetFrameTimes() const {
+    return m_frameTimes.data();
+  }
+  size_t GetFrameOffset() const {
+    return m_frames % windowSize;
+  }
+
+  // appends a line every interval, until StopLog
+  void StartLog(const std::string &path, float interval);
+  void StopLog();
+  bool Logging() const {
+    return m_log.is_open();
+  }
+};
+
+// counted into from the main thread
+extern FrameStats frameStats;
+
+} // namespace util
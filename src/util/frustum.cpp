@@ -1,4 +1,7 @@
 #include "frustum.hpp"
+#include "util/simd.hpp"
+#include <cassert>
+#include <utility>
 
 namespace util {
 
@@ -18,7 +21,7 @@ Frustum::Frustum(const glm::mat4 &mat) {
   }
 }
 
-bool Frustum::Intersects(const AABB &aabb) {
+bool Frustum::Intersects(const AABB &aabb) const {
   for (const auto &plane : planes) {
     // Calculate the most positive corner (in the direction of the plane normal)
     glm::vec3 positiveVertex = aabb.min;
@@ -36,4 +39,119 @@ bool Frustum::Intersects(const AABB &aabb) {
   return true;
 }
 
+Frustum::Containment Frustum::Classify(const AABB &aabb) const {
+  bool inside = true;
+  for (const auto &plane : planes) {
+    // most positive and most negative corners in the direction of the plane normal
+    glm::vec3 positiveVertex = aabb.min;
+    glm::vec3 negativeVertex = aabb.max;
+    if (plane.x >= 0) std::swap(positiveVertex.x, negativeVertex.x);
+    if (plane.y >= 0) std::swap(positiveVertex.y, negativeVertex.y);
+    if (plane.z >= 0) std::swap(positiveVertex.z, negativeVertex.z);
+
+    if (glm::dot(glm::vec3(plane), positiveVertex) + plane.w < 0) {
+      return Containment::Outside;
+    }
+    if (glm::dot(glm::vec3(plane), negativeVertex) + plane.w < 0) inside = false;
+  }
+
+  return inside ? Containment::Inside : Containment::Intersects;
+}
+
+void AABBSoA::Clear() {
+  for (auto *v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) v->clear();
+}
+
+void AABBSoA::Reserve(size_t size) {
+  for (auto *v : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) v->reserve(size);
+}
+
+void AABBSoA::Push(const AABB &aabb) {
+  minX.push_back(aabb.min.x);
+  minY.push_back(aabb.min.y);
+  minZ.push_back(aabb.min.z);
+  maxX.push_back(aabb.max.x);
+  maxY.push_back(aabb.max.y);
+  maxZ.push_back(aabb.max.z);
+}
+
+AABB AABBSoA::Get(size_t index) const {
+  return AABB{
+    {minX[index], minY[index], minZ[index]},
+    {maxX[index], maxY[index], maxZ[index]},
+  };
+}
+
+void IntersectsBatch(
+  std::span<const Frustum> frusta, const AABBSoA &boxes, size_t first, size_t count,
+  uint8_t *masks
+) {
+  using namespace simd;
+  assert(frusta.size() <= 8);
+  assert(first + count <= boxes.Size());
+
+  // the positive vertex only depends on the plane signs, so pick the bounds
+  // per plane once instead of per box
+  struct Plane {
+    floatN x, y, z, w;
+    const float *boundX, *boundY, *boundZ;
+  };
+  std::array<Plane, 8 * 6> planes;
+  size_t numPlanes = 0;
+  for (const auto &frustum : frusta) {
+    for (const auto &plane : frustum.planes) {
+      planes[numPlanes++] = Plane{
+        .x = Set(plane.x),
+        .y = Set(plane.y),
+        .z = Set(plane.z),
+        .w = Set(plane.w),
+        .boundX = plane.x >= 0 ? boxes.maxX.data() : boxes.minX.data(),
+        .boundY = plane.y >= 0 ? boxes.maxY.data() : boxes.minY.data(),
+        .boundZ = plane.z >= 0 ? boxes.maxZ.data() : boxes.minZ.data(),
+      };
+    }
+  }
+
+  constexpr int allLanes = (1 << width) - 1;
+  size_t end = first + count;
+  size_t i = first;
+  for (; i + width <= end; i += width) {
+    uint8_t *laneMasks = masks + (i - first);
+    for (int lane = 0; lane < width; lane++) laneMasks[lane] = 0;
+
+    for (size_t f = 0; f < frusta.size(); f++) {
+      // bit per lane, set once the box is behind any plane
+      int outside = 0;
+      for (size_t p = f * 6; p < f * 6 + 6 && outside != allLanes; p++) {
+        const auto &plane = planes[p];
+        floatN dist = plane.x * Load(plane.boundX + i) +
+                      plane.y * Load(plane.boundY + i) +
+                      plane.z * Load(plane.boundZ + i) + plane.w;
+        outside |= NegativeMask(dist);
+      }
+      int inside = ~outside & allLanes;
+      for (int lane = 0; lane < width; lane++) {
+        laneMasks[lane] |= ((inside >> lane) & 1) << f;
+      }
+    }
+  }
+
+  // leftovers that don't fill a whole vector
+  for (; i < end; i++) {
+    auto aabb = boxes.Get(i);
+    uint8_t mask = 0;
+    for (size_t f = 0; f < frusta.size(); f++) {
+      if (frusta[f].Intersects(aabb)) mask |= 1 << f;
+    }
+    masks[i - first] = mask;
+  }
+}
+
+void IntersectsBatch(
+  std::span<const Frustum> frusta, const AABBSoA &boxes, std::vector<uint8_t> &masks
+) {
+  masks.resize(boxes.Size());
+  IntersectsBatch(frusta, boxes, 0, boxes.Size(), masks.data());
+}
+
 } // namespace util
@@ -3,6 +3,9 @@
 #include "glm/ext/matrix_float4x4.hpp"
 #include "glm/ext/vector_float4.hpp"
 #include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
 
 namespace util {
 
@@ -12,12 +15,44 @@ struct AABB {
 };
 
 struct Frustum {
+  enum class Containment {
+    Outside,
+    Intersects,
+    Inside,
+  };
+
   // left, right, bottom, top, near, far
   std::array<glm::vec4, 6> planes;
 
   Frustum() = default;
   Frustum(const glm::mat4 &viewProj);
-  bool Intersects(const AABB &aabb);
+  bool Intersects(const AABB &aabb) const;
+  // like Intersects, but also tells if the AABB is fully inside
+  Containment Classify(const AABB &aabb) const;
 };
 
+// structure of arrays bounds, for testing many boxes at once
+struct AABBSoA {
+  std::vector<float> minX, minY, minZ;
+  std::vector<float> maxX, maxY, maxZ;
+
+  size_t Size() const {
+    return minX.size();
+  }
+  void Clear();
+  void Reserve(size_t size);
+  void Push(const AABB &aabb);
+  AABB Get(size_t index) const;
+};
+
+// tests boxes [first, first + count) against up to 8 frusta in one pass,
+// bit f of masks[i] is set if box (first + i) intersects frusta[f]
+void IntersectsBatch(
+  std::span<const Frustum> frusta, const AABBSoA &boxes, size_t first, size_t count,
+  uint8_t *masks
+);
+void IntersectsBatch(
+  std::span<const Frustum> frusta, const AABBSoA &boxes, std::vector<uint8_t> &masks
+);
+
 } // namespace util
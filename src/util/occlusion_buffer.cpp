@@ -0,0 +1,150 @@
+#include "occlusion_buffer.hpp"
+#include "util/simd.hpp"
+#include "glm/common.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace util {
+
+// boxes crossing this are never occluders and never occluded
+static constexpr float nearLimit = 0.1;
+
+// clamped before the int conversion, far off-screen corners can be huge
+static int ToPixel(float value, int size) {
+  return std::clamp(std::floor(value), -1.0f, (float)size);
+}
+
+OcclusionBuffer::OcclusionBuffer() : m_depth(width * height) {
+}
+
+void OcclusionBuffer::Clear(const glm::mat4 &viewProj) {
+  m_viewProj = viewProj;
+  std::fill(m_depth.begin(), m_depth.end(), std::numeric_limits<float>::infinity());
+}
+
+OcclusionBuffer::ScreenBox OcclusionBuffer::Project(const AABB &box) const {
+  ScreenBox screen{.valid = true};
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner(
+      i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+      i & 4 ? box.max.z : box.min.z
+    );
+    glm::vec4 clip = m_viewProj * glm::vec4(corner, 1.0);
+    if (clip.w < nearLimit) {
+      screen.valid = false;
+      return screen;
+    }
+    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+    screen.corners[i] = glm::vec3(
+      (ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, clip.w
+    );
+  }
+  return screen;
+}
+
+void OcclusionBuffer::AddOccluder(const AABB &box, glm::vec3 eye) {
+  auto screen = Project(box);
+  if (!screen.valid) return;
+
+  // corner i has max.x if bit 0, max.y if bit 1, max.z if bit 2
+  static constexpr std::array<std::array<int, 4>, 6> faces = {{
+    {0, 2, 6, 4}, // -x
+    {1, 3, 7, 5}, // +x
+    {0, 1, 5, 4}, // -y
+    {2, 3, 7, 6}, // +y
+    {0, 1, 3, 2}, // -z
+    {4, 5, 7, 6}, // +z
+  }};
+  const bool facing[6] = {
+    eye.x < box.min.x, eye.x > box.max.x, eye.y < box.min.y,
+    eye.y > box.max.y, eye.z < box.min.z, eye.z > box.max.z,
+  };
+  for (int i = 0; i < 6; i++) {
+    if (!facing[i]) continue;
+    auto &quad = faces[i];
+    auto &c = screen.corners;
+    RasterizeTriangle(c[quad[0]], c[quad[1]], c[quad[2]]);
+    RasterizeTriangle(c[quad[0]], c[quad[2]], c[quad[3]]);
+  }
+}
+
+void OcclusionBuffer::RasterizeTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+  float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  if (area == 0) return;
+  if (area < 0) std::swap(b, c);
+
+  int minX = std::max(0, ToPixel(std::min({a.x, b.x, c.x}), width));
+  int maxX = std::min(width - 1, ToPixel(std::max({a.x, b.x, c.x}), width));
+  int minY = std::max(0, ToPixel(std::min({a.y, b.y, c.y}), height));
+  int maxY = std::min(height - 1, ToPixel(std::max({a.y, b.y, c.y}), height));
+  if (minX > maxX || minY > maxY) return;
+  minX -= minX % simd::width; // width is a multiple of the lane count
+
+  // edge p -> q is x * px + y * py + c, >= 0 on the inside
+  struct Edge {
+    float x, y, c;
+  };
+  auto edge = [](glm::vec3 p, glm::vec3 q) {
+    return Edge{p.y - q.y, q.x - p.x, (q.y - p.y) * p.x - (q.x - p.x) * p.y};
+  };
+  const std::array<Edge, 3> edges = {edge(a, b), edge(b, c), edge(c, a)};
+
+  // flat and conservative, the whole triangle is as far as its farthest corner
+  const simd::floatN depth = simd::Set(std::max({a.z, b.z, c.z}));
+  alignas(32) float laneOffsets[simd::width];
+  for (int i = 0; i < simd::width; i++) laneOffsets[i] = i + 0.5f;
+  const simd::floatN lanes = simd::Load(laneOffsets);
+
+  for (int y = minY; y <= maxY; y++) {
+    float py = y + 0.5f;
+    float *row = &m_depth[y * width];
+    for (int x = minX; x <= maxX; x += simd::width) {
+      simd::floatN px = lanes + simd::Set(x);
+      // negative in lanes outside any edge
+      simd::floatN inside = simd::Set(std::numeric_limits<float>::infinity());
+      for (auto &e : edges) {
+        auto value = simd::Set(e.x) * px + simd::Set(e.y * py + e.c);
+        inside = simd::Min(inside, value);
+      }
+      simd::floatN current = simd::Load(row + x);
+      simd::Store(row + x, simd::Select(inside, current, simd::Min(current, depth)));
+    }
+  }
+}
+
+bool OcclusionBuffer::IsOccluded(const AABB &box) const {
+  auto screen = Project(box);
+  if (!screen.valid) return false;
+
+  glm::vec2 min(std::numeric_limits<float>::infinity());
+  glm::vec2 max(-std::numeric_limits<float>::infinity());
+  float nearest = std::numeric_limits<float>::infinity();
+  for (auto &corner : screen.corners) {
+    min = glm::min(min, glm::vec2(corner));
+    max = glm::max(max, glm::vec2(corner));
+    nearest = std::min(nearest, corner.z);
+  }
+
+  // every pixel the rect touches, off-screen parts are left to frustum culling
+  int minX = std::max(0, ToPixel(min.x, width));
+  int maxX = std::min(width - 1, ToPixel(max.x, width));
+  int minY = std::max(0, ToPixel(min.y, height));
+  int maxY = std::min(height - 1, ToPixel(max.y, height));
+  if (minX > maxX || minY > maxY) return false;
+  minX -= minX % simd::width;
+
+  // extra lanes left of the rect only make the test more conservative
+  simd::floatN farthest = simd::Set(0);
+  for (int y = minY; y <= maxY; y++) {
+    const float *row = &m_depth[y * width];
+    for (int x = minX; x <= maxX; x += simd::width) {
+      farthest = simd::Max(farthest, simd::Load(row + x));
+    }
+  }
+  alignas(32) float lanes[simd::width];
+  simd::Store(lanes, farthest);
+  return *std::max_element(lanes, lanes + simd::width) < nearest;
+}
+
+} // namespace util
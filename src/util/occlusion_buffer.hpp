@@ -0,0 +1,38 @@
+#pragma once
+
+#include "glm/ext/matrix_float4x4.hpp"
+#include "util/frustum.hpp"
+#include <array>
+#include <vector>
+
+namespace util {
+
+// small cpu depth buffer for software occlusion culling. occluder boxes are drawn
+// with the farthest depth of each triangle, boxes are tested against the farthest
+// depth under their screen rect, so a box is only reported hidden if it really is
+class OcclusionBuffer {
+public:
+  static constexpr int width = 256;
+  static constexpr int height = 128;
+
+private:
+  // depth is clip w (distance along the view direction), cleared to infinity
+  std::vector<float> m_depth;
+  glm::mat4 m_viewProj;
+
+  struct ScreenBox {
+    std::array<glm::vec3, 8> corners; // pixels, depth
+    bool valid; // every corner past the near limit
+  };
+  ScreenBox Project(const AABB &box) const;
+  void RasterizeTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c);
+
+public:
+  OcclusionBuffer();
+  void Clear(const glm::mat4 &viewProj);
+  // only faces towards eye are drawn, add occluders front to back
+  void AddOccluder(const AABB &box, glm::vec3 eye);
+  bool IsOccluded(const AABB &box) const;
+};
+
+} // namespace util
@@ -0,0 +1,95 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace util {
+
+namespace {
+
+using Ring = Profiler::Ring;
+
+// rings outlive their threads so a dump still sees them
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::set<std::string> names;
+  // ticks at a known time, a dump measures the tick rate from here
+  int64_t startTicks = Profiler::Now();
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+};
+
+Registry &GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+} // namespace
+
+Profiler::Ring *Profiler::NewRing() {
+  auto &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  auto &ring = registry.rings.emplace_back(std::make_unique<Ring>());
+  ring->threadId = registry.rings.size();
+  return ring.get();
+}
+
+const char *Profiler::Intern(const std::string &name) {
+  auto &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  return registry.names.insert(name).first->c_str();
+}
+
+void Profiler::DumpTrace(const std::string &path) {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Cannot write " << path << std::endl;
+    return;
+  }
+
+  auto &registry = GetRegistry();
+  std::lock_guard lock(registry.mutex);
+  struct Range {
+    Ring *ring;
+    uint64_t first, last;
+  };
+  std::vector<Range> ranges;
+  int64_t origin = INT64_MAX;
+  for (auto &ring : registry.rings) {
+    uint64_t count = ring->count.load(std::memory_order_acquire);
+    uint64_t first = count > ringSize ? count - ringSize : 0;
+    ranges.push_back({ring.get(), first, count});
+    for (uint64_t i = first; i < count; i++) {
+      origin = std::min(origin, ring->events[i % ringSize].start);
+    }
+  }
+
+  double ticks = Now() - registry.startTicks;
+  double us = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - registry.startTime
+  )
+                .count();
+  double usPerTick = ticks > 0 ? us / ticks : 0;
+
+  // complete events, microseconds from the oldest one
+  file << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  const char *separator = "\n";
+  for (auto &range : ranges) {
+    for (uint64_t i = range.first; i < range.last; i++) {
+      auto &event = range.ring->events[i % ringSize];
+      file << separator << "  {\"name\": \"" << event.name
+           << "\", \"ph\": \"X\", \"ts\": " << (event.start - origin) * usPerTick
+           << ", \"dur\": " << (event.end - event.start) * usPerTick
+           << ", \"pid\": 1, \"tid\": " << range.ring->threadId << "}";
+      separator = ",\n";
+    }
+  }
+  file << "\n]}\n";
+}
+
+} // namespace util
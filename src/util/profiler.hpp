@@ -0,0 +1,96 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64)
+#include <intrin.h>
+#endif
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+// scoped cpu zones, dumped as chrome trace events (chrome://tracing, perfetto).
+// every thread records into its own ring that keeps the latest events, a zone is
+// two counter reads and a few stores, cheap enough to stay on
+class Profiler {
+public:
+  static constexpr size_t ringSize = 1 << 16; // events per thread
+
+  struct Event {
+    const char *name;
+    int64_t start, end; // ticks
+  };
+
+  struct Ring {
+    std::array<Event, ringSize> events;
+    // events ever recorded, the ring holds the last ringSize
+    std::atomic<uint64_t> count = 0;
+    uint32_t threadId;
+  };
+
+  // ticks, scaled to time when dumped. the time stamp counter on x86 is about half
+  // the cost of steady_clock
+  static int64_t Now() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()
+    )
+      .count();
+#endif
+  }
+  // a slot for the next event on this thread, valid until ringSize more are taken.
+  // the event is published before it's filled, a dump may see it torn
+  static Event *NextEvent() {
+    Ring *ring = t_ring;
+    if (!ring) ring = t_ring = NewRing();
+    // only this thread writes the ring, the release lets a dump see the event
+    uint64_t count = ring->count.load(std::memory_order_relaxed);
+    ring->count.store(count + 1, std::memory_order_release);
+    return &ring->events[count & (ringSize - 1)];
+  }
+  // name must outlive the event, a literal or from Intern
+  static void Record(const char *name, int64_t start, int64_t end) {
+    *NextEvent() = {name, start, end};
+  }
+  // a copy of name that lives as long as the program, for names built at runtime
+  static const char *Intern(const std::string &name);
+  // the events in every ring. other threads keep recording, events they write
+  // meanwhile may come out torn
+  static void DumpTrace(const std::string &path);
+
+private:
+  static Ring *NewRing();
+  // constinit, so reading it skips the thread_local init check
+  static inline constinit thread_local Ring *t_ring = nullptr;
+};
+
+// takes its event when it opens and only writes the end tick when it closes, a zone
+// still open shows with no duration
+class ProfileZone {
+private:
+  Profiler::Event *m_event;
+
+public:
+  ProfileZone(const char *name) : m_event(Profiler::NextEvent()) {
+    int64_t start = Profiler::Now();
+    *m_event = {name, start, start};
+  }
+  ~ProfileZone() {
+    m_event->end = Profiler::Now();
+  }
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+} // namespace util
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// times the rest of the enclosing scope
+#define PROFILE_ZONE(name) util::ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
@@ -0,0 +1,180 @@
+#pragma once
+
+// fixed width float vector for hot loops, uses the widest instruction set available
+// (avx: 8 lanes, sse2/neon: 4 lanes, otherwise a scalar fallback with 1 lane)
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#else
+#include <algorithm>
+#include <cmath>
+#endif
+
+namespace util::simd {
+
+#if defined(__AVX__)
+
+constexpr int width = 8;
+struct floatN {
+  __m256 v;
+};
+
+inline floatN Load(const float *ptr) {
+  return {_mm256_loadu_ps(ptr)};
+}
+inline floatN Set(float value) {
+  return {_mm256_set1_ps(value)};
+}
+inline floatN operator+(floatN a, floatN b) {
+  return {_mm256_add_ps(a.v, b.v)};
+}
+inline floatN operator*(floatN a, floatN b) {
+  return {_mm256_mul_ps(a.v, b.v)};
+}
+// bit i is set if lane i is less than zero
+inline int NegativeMask(floatN a) {
+  return _mm256_movemask_ps(_mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_LT_OQ));
+}
+inline void Store(float *ptr, floatN a) {
+  _mm256_storeu_ps(ptr, a.v);
+}
+inline floatN operator-(floatN a, floatN b) {
+  return {_mm256_sub_ps(a.v, b.v)};
+}
+inline floatN Min(floatN a, floatN b) {
+  return {_mm256_min_ps(a.v, b.v)};
+}
+inline floatN Max(floatN a, floatN b) {
+  return {_mm256_max_ps(a.v, b.v)};
+}
+// lanes of a where cond has its sign bit set, lanes of b elsewhere
+inline floatN Select(floatN cond, floatN a, floatN b) {
+  return {_mm256_blendv_ps(b.v, a.v, cond.v)};
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+constexpr int width = 4;
+struct floatN {
+  __m128 v;
+};
+
+inline floatN Load(const float *ptr) {
+  return {_mm_loadu_ps(ptr)};
+}
+inline floatN Set(float value) {
+  return {_mm_set1_ps(value)};
+}
+inline floatN operator+(floatN a, floatN b) {
+  return {_mm_add_ps(a.v, b.v)};
+}
+inline floatN operator*(floatN a, floatN b) {
+  return {_mm_mul_ps(a.v, b.v)};
+}
+inline int NegativeMask(floatN a) {
+  return _mm_movemask_ps(_mm_cmplt_ps(a.v, _mm_setzero_ps()));
+}
+inline void Store(float *ptr, floatN a) {
+  _mm_storeu_ps(ptr, a.v);
+}
+inline floatN operator-(floatN a, floatN b) {
+  return {_mm_sub_ps(a.v, b.v)};
+}
+inline floatN Min(floatN a, floatN b) {
+  return {_mm_min_ps(a.v, b.v)};
+}
+inline floatN Max(floatN a, floatN b) {
+  return {_mm_max_ps(a.v, b.v)};
+}
+inline floatN Select(floatN cond, floatN a, floatN b) {
+  __m128 mask = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(cond.v), 31));
+  return {_mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v))};
+}
+
+#elif defined(__ARM_NEON)
+
+constexpr int width = 4;
+struct floatN {
+  float32x4_t v;
+};
+
+inline floatN Load(const float *ptr) {
+  return {vld1q_f32(ptr)};
+}
+inline floatN Set(float value) {
+  return {vdupq_n_f32(value)};
+}
+inline floatN operator+(floatN a, floatN b) {
+  return {vaddq_f32(a.v, b.v)};
+}
+inline floatN operator*(floatN a, floatN b) {
+  return {vmulq_f32(a.v, b.v)};
+}
+inline int NegativeMask(floatN a) {
+  const int32x4_t shifts = {0, 1, 2, 3};
+  uint32x4_t negative = vshrq_n_u32(vcltq_f32(a.v, vdupq_n_f32(0)), 31);
+  return vaddvq_u32(vshlq_u32(negative, shifts));
+}
+inline void Store(float *ptr, floatN a) {
+  vst1q_f32(ptr, a.v);
+}
+inline floatN operator-(floatN a, floatN b) {
+  return {vsubq_f32(a.v, b.v)};
+}
+inline floatN Min(floatN a, floatN b) {
+  return {vminq_f32(a.v, b.v)};
+}
+inline floatN Max(floatN a, floatN b) {
+  return {vmaxq_f32(a.v, b.v)};
+}
+inline floatN Select(floatN cond, floatN a, floatN b) {
+  uint32x4_t mask =
+    vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_f32(cond.v), 31));
+  return {vbslq_f32(mask, a.v, b.v)};
+}
+
+#else
+
+constexpr int width = 1;
+struct floatN {
+  float v;
+};
+
+inline floatN Load(const float *ptr) {
+  return {*ptr};
+}
+inline floatN Set(float value) {
+  return {value};
+}
+inline floatN operator+(floatN a, floatN b) {
+  return {a.v + b.v};
+}
+inline floatN operator*(floatN a, floatN b) {
+  return {a.v * b.v};
+}
+inline int NegativeMask(floatN a) {
+  return a.v < 0;
+}
+inline void Store(float *ptr, floatN a) {
+  *ptr = a.v;
+}
+inline floatN operator-(floatN a, floatN b) {
+  return {a.v - b.v};
+}
+inline floatN Min(floatN a, floatN b) {
+  return {std::min(a.v, b.v)};
+}
+inline floatN Max(floatN a, floatN b) {
+  return {std::max(a.v, b.v)};
+}
+inline floatN Select(floatN cond, floatN a, floatN b) {
+  return std::signbit(cond.v) ? a : b;
+}
+
+#endif
+
+} // namespace util::simd
@@ -1,5 +1,6 @@
 #include "texture.hpp"
 
+#include "util/frame_stats.hpp"
 #include "util/webgpu-util.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -73,9 +74,9 @@ Texture LoadTextureMipmap(gfx::Context &ctx, std::filesystem::path path) {
       .bytesPerRow = 4 * currSize.width,
       .rowsPerImage = currSize.height,
     };
-    ctx.queue.WriteTexture(
-      &destination, currData, currSize.width * currSize.height * 4, &source, &currSize
-    );
+    size_t dataSize = currSize.width * currSize.height * 4;
+    ctx.queue.WriteTexture(&destination, currData, dataSize, &source, &currSize);
+    frameStats.counters.bytesUploaded += dataSize;
   }
 
   stbi_image_free(currData);
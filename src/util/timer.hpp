@@ -1,18 +1,15 @@
 #pragma once
 
-#include <vector>
-
 namespace util {
 
+// frame times and fps are kept by FrameStats
 class Timer {
 private:
   float m_currTime;
   float m_prevTime;
-  std::vector<float> m_dtList;
 public:
   Timer();
   float Tick();
-  float GetFps();
 };
 
 } // namespace util
@@ -1,7 +1,9 @@
 #include "webgpu-util.hpp"
 #include "dawn/utils/WGPUHelpers.h"
+#include "util/frame_stats.hpp"
 #include <iostream>
 #include <fstream>
+#include <set>
 #include <sstream>
 
 namespace util {
@@ -73,15 +75,34 @@ void SetUncapturedErrorCallback(Device &device) {
   device.SetUncapturedErrorCallback(onUncapturedError, nullptr);
 }
 
-ShaderModule LoadShaderModule(const fs::path &path, Device &device) {
+// pastes in the files named by "// #include "file.wgsl"" lines, relative to the
+// including file, each file at most once
+static void ReadShaderSource(
+  const fs::path &path, std::stringstream &source, std::set<fs::path> &included
+) {
+  if (!included.insert(fs::weakly_canonical(path)).second) return;
   std::ifstream file(path);
   if (!file.is_open()) {
     throw std::runtime_error("Could not open shader file" + path.string());
   }
-  std::stringstream buffer;
-  buffer << file.rdbuf();
+  const std::string directive = "// #include \"";
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.starts_with(directive) && line.ends_with('"')) {
+      auto name = line.substr(directive.size(), line.size() - directive.size() - 1);
+      ReadShaderSource(path.parent_path() / name, source, included);
+    } else {
+      source << line << '\n';
+    }
+  }
+}
 
-  return dawn::utils::CreateShaderModule(device, buffer.str());
+ShaderModule LoadShaderModule(const fs::path &path, Device &device) {
+  std::stringstream source;
+  std::set<fs::path> included;
+  ReadShaderSource(path, source, included);
+
+  return dawn::utils::CreateShaderModule(device, source.str());
 }
 
 // clang-format off
@@ -129,7 +150,7 @@ wgpu::Buffer CreateBuffer(
     .size = size,
   };
   Buffer buffer = device.CreateBuffer(&bufferDesc);
-  if (data) device.GetQueue().WriteBuffer(buffer, 0, data, size);
+  if (data) WriteBuffer(device.GetQueue(), buffer, 0, data, size);
   return buffer;
 }
 
@@ -149,6 +170,14 @@ wgpu::Buffer CreateStorageBuffer(wgpu::Device &device, size_t size, const void *
   return CreateBuffer(device, BufferUsage::Storage, size, data);
 }
 
+void WriteBuffer(
+  const wgpu::Queue &queue, const wgpu::Buffer &buffer, uint64_t offset,
+  const void *data, size_t size
+) {
+  queue.WriteBuffer(buffer, offset, data, size);
+  frameStats.counters.bytesUploaded += size;
+}
+
 wgpu::Texture CreateTexture(
   wgpu::Device &device,
   wgpu::Extent3D size,
@@ -170,9 +199,9 @@ wgpu::Texture CreateTexture(
       .bytesPerRow = size.width * texelBlockSize,
       .rowsPerImage = size.height,
     };
-    device.GetQueue().WriteTexture(
-      &destination, data, size.width * size.height * texelBlockSize, &dataLayout, &size
-    );
+    size_t dataSize = size.width * size.height * texelBlockSize;
+    device.GetQueue().WriteTexture(&destination, data, dataSize, &dataLayout, &size);
+    frameStats.counters.bytesUploaded += dataSize;
   }
   return texture;
 }
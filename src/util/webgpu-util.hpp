@@ -15,6 +15,7 @@ wgpu::Device RequestDevice(wgpu::Adapter &instance, wgpu::DeviceDescriptor const
 
 void SetUncapturedErrorCallback(wgpu::Device &device);
 
+// pastes in lines of the form // #include "file.wgsl", see res/shaders/gbuffer.wgsl
 wgpu::ShaderModule LoadShaderModule(const fs::path &path, wgpu::Device &device);
 
 void PrintLimits(wgpu::Limits const &limits);
@@ -24,6 +25,8 @@ wgpu::Buffer CreateVertexBuffer(wgpu::Device &device, size_t size, const void *d
 wgpu::Buffer CreateIndexBuffer(wgpu::Device &device, size_t size, const void *data = nullptr);
 wgpu::Buffer CreateUniformBuffer(wgpu::Device &device, size_t size, const void *data = nullptr);
 wgpu::Buffer CreateStorageBuffer(wgpu::Device &device, size_t size, const void *data = nullptr);
+// queue.WriteBuffer, counted in FrameStats
+void WriteBuffer(const wgpu::Queue &queue, const wgpu::Buffer &buffer, uint64_t offset, const void *data, size_t size);
 
 wgpu::Texture CreateTexture(wgpu::Device &device, wgpu::Extent3D size, wgpu::TextureFormat format, const void *data = nullptr);
 wgpu::Texture CreateRenderTexture(wgpu::Device &device, wgpu::Extent3D size, wgpu::TextureFormat format);